@@ -26,7 +26,6 @@
 
 #include "utils/time.h"
 #include "utils/pt.h"
-#include "utils/fifo.h"
 
 
 //----------------------------------------
@@ -39,8 +38,9 @@
 #define ALV_LOWER_TRIGGER				0x02
 
 #define ALV_TIME_INTERVAL				TIME_1_SEC
+#define ALV_RESP_TIME_OUT				(ALV_TIME_INTERVAL / 2)
 
-#define QUEUE_SIZE						3
+#define ALV_NB_MNT						2
 
 
 //----------------------------------------
@@ -50,7 +50,6 @@
 static struct {
 	dpt_interface_t interf;		// dispatcher interface
 
-	pt_t rx_pt;					// rx context
 	pt_t tx_pt;					// tx context
 
 	frame_t fr;					// a buffer frame
@@ -59,13 +58,14 @@ static struct {
 	u8 trigger;					// signal if the action has already happened
 
 	u8 nb_mnt;					// number of other found minuteries
-	u8 mnt_addr[2];				// addresses of the other minuteries
+	u8 mnt_addr[ALV_NB_MNT];	// addresses of the other minuteries
 	u8 cur_mnt;					// current minuterie index
 
-	u32 time_out;				// time-out for scan request sending
+	u8 call[ALV_NB_MNT];		// status request of each minuterie
+	u8 pending;					// status requests waiting for their response bitfield
+	u8 is_alive;				// TRUE if a minuterie responded in this scan
 
-	frame_t buf[QUEUE_SIZE];
-	fifo_t in_fifo;				// reception queue
+	u32 time_out;				// time-out for scan request sending
 } ALV;
 
 
@@ -87,8 +87,9 @@ static u8 ALV_nodes_addresses(void)
 	// extract the other minuteries addresses
 	for ( i = DNA_FIRST_IS_INDEX(nb_is); i <= DNA_LAST_IS_INDEX(nb_is); i++ ) {
 		// same type but different address
+		// and room left to save it
 		if ( (list[i].type == DNA_SELF_TYPE(list)) &&
-			( list[i].i2c_addr != DNA_SELF_ADDR(list)) ) {
+			( list[i].i2c_addr != DNA_SELF_ADDR(list)) && (nb < ALV_NB_MNT) ) {
 			// an other minuterie is found
 			// save its address
 			ALV.mnt_addr[nb] = list[i].i2c_addr;
@@ -106,67 +107,31 @@ static u8 ALV_nodes_addresses(void)
 }
 
 
-static u8 ALV_next_address(void)
-{
-	u8 addr;
-
-	// if no other minuterie is visible
-	if ( ALV.nb_mnt == 0 ) {
-		// return an invalid address (it is in the range of the BS)
-		return DPT_LAST_ADDR;
-	}
-
-	// so at least 1 other minuterie is declared
-	// ensure the current MNT index is valid
-	ALV.cur_mnt %= ALV.nb_mnt;
-
-	// retrieve its address
-	addr = ALV.mnt_addr[ALV.cur_mnt];
-
-	// finally prepare the access to the next minuterie
-	ALV.cur_mnt++;
-
-	// return the computed address
-	return addr;
-}
-
-
-static PT_THREAD( ALV_rx(pt_t* pt) )
+// collect the responses of the status requests
+// return OK when every request is completed
+static u8 ALV_responses(void)
 {
 	frame_t fr;
+	u8 i;
 
-	PT_BEGIN(pt);
-
-	PT_WAIT_UNTIL(pt, FIFO_get(&ALV.in_fifo, &fr));
-
-	// if not the response from current status request
-	if ( !fr.resp || (fr.t_id != ALV.fr.t_id) ) {
-		// throw it away
-		PT_RESTART(pt);
-	}
-
-	// if response is not in error
-	if ( !fr.error ) {
-		// increase number of successes
-		ALV.anti_bounce++;
+	for ( i = 0; i < ALV.nb_mnt; i++ ) {
+		// if the response of this minuterie is received
+		if ( (ALV.pending & (1 << i)) && DPT_call_done(&ALV.interf, ALV.call[i], &fr) ) {
+			ALV.pending &= ~(1 << i);
 
-		// prevent overflow
-		if ( ALV.anti_bounce > ALV_ANTI_BOUNCE_UPPER_LIMIT ) {
-			ALV.anti_bounce = ALV_ANTI_BOUNCE_UPPER_LIMIT;
+			// if response is neither in error nor timed out
+			if ( !fr.error && !fr.time_out ) {
+				ALV.is_alive = TRUE;
+			}
 		}
 	}
 
-	// loop back
-	PT_RESTART(pt);
-
-	PT_END(pt);
+	return ALV.pending ? KO : OK;
 }
 
 
 static PT_THREAD( ALV_tx(pt_t* pt) )
 {
-	u8 self_addr;
-
 	PT_BEGIN(pt);
 
 	// every second
@@ -176,23 +141,41 @@ static PT_THREAD( ALV_tx(pt_t* pt) )
 	ALV.time_out += ALV_TIME_INTERVAL;
 
 	// extract visible other minuteries addresses
-	self_addr = ALV_nodes_addresses();
+	// and build the get state request
+	// (it is kept in ALV.fr as the thread yields while sending it)
+	ALV.fr.orig = ALV_nodes_addresses();
+	ALV.fr.resp = 0;
+	ALV.fr.error = 0;
+	//ALV.fr.nat = 0;
+	ALV.fr.cmde = FR_STATE;
+	ALV.fr.argv[0] = 0x00;
 
 	// if another minuterie is visible
 	if ( ALV.nb_mnt != 0 ) {
-		// build the get state request
-		ALV.fr.orig = self_addr;
-		ALV.fr.dest = ALV_next_address();
-		ALV.fr.resp = 0;
-		ALV.fr.error = 0;
-		//ALV.fr.nat = 0;
-		ALV.fr.cmde = FR_STATE;
-		ALV.fr.argv[0] = 0x00;
+		// request the status of every minuterie at once
+		ALV.is_alive = FALSE;
+		for ( ALV.cur_mnt = 0; ALV.cur_mnt < ALV.nb_mnt; ALV.cur_mnt++ ) {
+			// only the destination differs
+			ALV.fr.dest = ALV.mnt_addr[ALV.cur_mnt];
+
+			// send the status request
+			PT_WAIT_UNTIL(pt, OK == DPT_call(&ALV.interf, &ALV.fr, ALV_RESP_TIME_OUT, &ALV.call[ALV.cur_mnt]));
+			ALV.pending |= 1 << ALV.cur_mnt;
+		}
 
-		// send the status request
-		DPT_lock(&ALV.interf);
-		PT_WAIT_UNTIL(pt, OK == DPT_tx(&ALV.interf, &ALV.fr));
-		DPT_unlock(&ALV.interf);
+		// wait for every response
+		PT_WAIT_UNTIL(pt, ALV_responses());
+
+		// if any minuterie is alive
+		if ( ALV.is_alive ) {
+			// increase number of successes
+			ALV.anti_bounce++;
+
+			// prevent overflow
+			if ( ALV.anti_bounce > ALV_ANTI_BOUNCE_UPPER_LIMIT ) {
+				ALV.anti_bounce = ALV_ANTI_BOUNCE_UPPER_LIMIT;
+			}
+		}
 	}
 	else {
 		// one more failure
@@ -264,7 +247,6 @@ static PT_THREAD( ALV_tx(pt_t* pt) )
 void ALV_init(void)
 {
 	// threads context init
-	PT_INIT(&ALV.rx_pt);
 	PT_INIT(&ALV.tx_pt);
 
 	// variables init
@@ -272,14 +254,14 @@ void ALV_init(void)
 	ALV.trigger = 0x00;
 	ALV.nb_mnt = 0;
 	ALV.cur_mnt = 0;
+	ALV.pending = 0;
 	ALV.time_out = ALV_TIME_INTERVAL;
 
-	FIFO_init(&ALV.in_fifo, &ALV.buf, QUEUE_SIZE, sizeof(ALV.buf[0]));
-
-	// register own call-back for specific commands
+	// register to dispatcher
+	// the responses are received through the calls
 	ALV.interf.channel = 9;
-	ALV.interf.cmde_mask = _CM(FR_STATE);
-	ALV.interf.queue = &ALV.in_fifo;
+	ALV.interf.cmde_mask = NULL;
+	ALV.interf.queue = NULL;
 	DPT_register(&ALV.interf);
 }
 
@@ -287,9 +269,14 @@ void ALV_init(void)
 // ALIVE module run method
 void ALV_run(void)
 {
-	// handle response if any
-	(void)PT_SCHEDULE(ALV_rx(&ALV.rx_pt));
+	// nothing to do until a response or the next request time
+	if ( !DPT_ready(&ALV.interf) ) {
+		return;
+	}
 
-	// send response if any
+	// send the requests and handle their responses
 	(void)PT_SCHEDULE(ALV_tx(&ALV.tx_pt));
+
+	// next status request
+	DPT_wake_at(&ALV.interf, ALV.time_out);
 }
@@ -39,8 +39,6 @@
 // private defines
 //
 
-#define NB_IN_FRAMES	3	// number of incoming frames
-
 #define NB_OUT_FRAMES	7	// number of response frames
 
 
@@ -55,8 +53,8 @@ static struct {
 	// for incoming frames
 	pt_t	in_pt;						// context
 	fifo_t	in_fifo;					// fifo
-	frame_t in_buf[NB_IN_FRAMES];		// buffer
-	frame_t in;
+	frame_t* in_buf[BSC_NB_IN];		// buffer
+	frame_t* in;						// handled frame (shared with the dispatcher)
 
 	// for response frames
 	pt_t	out_pt;						// context
@@ -91,32 +89,32 @@ PT_THREAD(BSC_frame_handling(pt_t* pt))
 	BSC.is_running = TRUE;
 
 	// if receiving a response or an error frame
-	if ( BSC.in.resp || BSC.in.error ) {
+	if ( BSC.in->resp || BSC.in->error ) {
 		// ignore it
 		BSC.is_running = FALSE;
 		PT_EXIT(pt);
 	}
 
 	// build response frame
-	BSC.resp.dest = BSC.in.orig;
-	BSC.resp.orig = BSC.in.dest;
-	BSC.resp.t_id = BSC.in.t_id;
+	BSC.resp.dest = BSC.in->orig;
+	BSC.resp.orig = BSC.in->dest;
+	BSC.resp.t_id = BSC.in->t_id;
 	BSC.resp.resp = 1;
-	BSC.resp.error = BSC.in.error;
-	BSC.resp.cmde = BSC.in.cmde;
-	BSC.resp.eth = BSC.in.eth;
-	BSC.resp.serial = BSC.in.serial;
-	BSC.resp.argv[0] = BSC.in.argv[0];
-	BSC.resp.argv[1] = BSC.in.argv[1];
-	BSC.resp.argv[2] = BSC.in.argv[2];
-	BSC.resp.argv[3] = BSC.in.argv[3];
-	BSC.resp.argv[4] = BSC.in.argv[4];
-	BSC.resp.argv[5] = BSC.in.argv[5];
+	BSC.resp.error = BSC.in->error;
+	BSC.resp.cmde = BSC.in->cmde;
+	BSC.resp.eth = BSC.in->eth;
+	BSC.resp.serial = BSC.in->serial;
+	BSC.resp.argv[0] = BSC.in->argv[0];
+	BSC.resp.argv[1] = BSC.in->argv[1];
+	BSC.resp.argv[2] = BSC.in->argv[2];
+	BSC.resp.argv[3] = BSC.in->argv[3];
+	BSC.resp.argv[4] = BSC.in->argv[4];
+	BSC.resp.argv[5] = BSC.in->argv[5];
 
 	// extract address (in most frames, the 2 first argv are an u16)
-	BSC.addr = (u16*)( (u16)(BSC.in.argv[0] << 8) + BSC.in.argv[1] );
+	BSC.addr = (u16*)( (u16)(BSC.in->argv[0] << 8) + BSC.in->argv[1] );
 
-	switch (BSC.in.cmde) {
+	switch (BSC.in->cmde) {
 	case FR_NO_CMDE:
 		// nothing to do
 		break;
@@ -131,7 +129,7 @@ PT_THREAD(BSC_frame_handling(pt_t* pt))
 
 	case FR_RAM_WRITE:
 		// extract data
-		BSC.data = (BSC.in.argv[2] << 8) + BSC.in.argv[3];
+		BSC.data = (BSC.in->argv[2] << 8) + BSC.in->argv[3];
 
 		// write data
 		*BSC.addr = BSC.data;
@@ -155,7 +153,7 @@ PT_THREAD(BSC_frame_handling(pt_t* pt))
 
 	case FR_EEP_WRITE:
 		// extract data
-		BSC.data = (BSC.in.argv[2] << 8) + BSC.in.argv[3];
+		BSC.data = (BSC.in->argv[2] << 8) + BSC.in->argv[3];
 
 		// write data
 		EEP_write((u16)BSC.addr, (u8*)&BSC.data, sizeof(u16));
@@ -193,7 +191,7 @@ PT_THREAD(BSC_frame_handling(pt_t* pt))
 
 	case FR_SPI_READ:
 		// only read data
-		SPI_master(NULL, 0, BSC.resp.argv, BSC.in.len);
+		SPI_master(NULL, 0, BSC.resp.argv, BSC.in->len);
 
 		// wait until reading is done
 		PT_WAIT_UNTIL(pt, SPI_is_fini());
@@ -204,7 +202,7 @@ PT_THREAD(BSC_frame_handling(pt_t* pt))
 
 	case FR_SPI_WRITE:
 		// only write data
-		SPI_master(BSC.in.argv, BSC.in.len, NULL, 0);
+		SPI_master(BSC.in->argv, BSC.in->len, NULL, 0);
 
 		// wait until writing is done
 		PT_WAIT_UNTIL(pt, SPI_is_fini());
@@ -231,10 +229,10 @@ PT_THREAD(BSC_frame_handling(pt_t* pt))
 		// except perhaps for eeprom size optimization
 
 		// upon the memory storage zone
-		switch (BSC.in.argv[3]) {
+		switch (BSC.in->argv[3]) {
 		case EEPROM_STORAGE:
 			// for each frame in the container
-			for ( BSC.i = 0; BSC.i < BSC.in.argv[2]; BSC.i++) {
+			for ( BSC.i = 0; BSC.i < BSC.in->argv[2]; BSC.i++) {
 				// extract the frames from EEPROM
 				EEP_read((u16)((u8*)BSC.addr + BSC.i * sizeof(frame_t)), (u8*)&BSC.cont, sizeof(frame_t));
 
@@ -248,7 +246,7 @@ PT_THREAD(BSC_frame_handling(pt_t* pt))
 
 		case RAM_STORAGE:
 			// for each frame in the container
-			for ( BSC.i = 0; BSC.i < BSC.in.argv[2]; BSC.i++) {
+			for ( BSC.i = 0; BSC.i < BSC.in->argv[2]; BSC.i++) {
 				// read the frame from RAM
 				BSC.cont = *((frame_t *)((u8*)BSC.addr + BSC.i * sizeof(frame_t)));
 
@@ -259,7 +257,7 @@ PT_THREAD(BSC_frame_handling(pt_t* pt))
 
 		case FLASH_STORAGE:
 			// for each frame in the container
-			for ( BSC.i = 0; BSC.i < BSC.in.argv[2]; BSC.i++) {
+			for ( BSC.i = 0; BSC.i < BSC.in->argv[2]; BSC.i++) {
 				// extract the frame from FLASH
 				memcpy_P(&BSC.cont, (const void *)((u8*)BSC.addr + BSC.i * sizeof(frame_t)), sizeof(frame_t));
 
@@ -275,7 +273,7 @@ PT_THREAD(BSC_frame_handling(pt_t* pt))
 		case PRE_4_STORAGE:
 		case PRE_5_STORAGE:
 			// extract the frame from EEPROM
-			EEP_read((u16)((u8*)BSC.addr + BSC.in.argv[3] * sizeof(frame_t)), (u8*)&BSC.cont, sizeof(frame_t));
+			EEP_read((u16)((u8*)BSC.addr + BSC.in->argv[3] * sizeof(frame_t)), (u8*)&BSC.cont, sizeof(frame_t));
 
 			// wait until reading is done
 			PT_WAIT_UNTIL(pt, EEP_is_fini());
@@ -322,6 +320,9 @@ PT_THREAD(BSC_in(pt_t* pt))
 	// frame interpretation
 	PT_SPAWN(pt, &BSC.handling_pt, BSC_frame_handling(&BSC.handling_pt));
 
+	// the incoming frame is no more needed
+	DPT_free(BSC.in);
+
 	// if the last handled frame was a wait one
 	// no other one will be treated before the time-out elapses
 	PT_WAIT_WHILE(pt, (0 != BSC.time_out) && (TIME_get() <= BSC.time_out));
@@ -371,7 +372,7 @@ void BSC_init(void)
 	frame_t fr;
 
 	// fifoes init
-	FIFO_init(&BSC.in_fifo, &BSC.in_buf, NB_IN_FRAMES, sizeof(frame_t));
+	FIFO_init(&BSC.in_fifo, &BSC.in_buf, BSC_NB_IN, sizeof(BSC.in_buf[0]));
 	FIFO_init(&BSC.out_fifo, &BSC.out_buf, NB_OUT_FRAMES, sizeof(frame_t));
 
 	// thread init
@@ -384,17 +385,7 @@ void BSC_init(void)
 
 	// register own call-back for specific commands
 	BSC.interf.channel = 0;
-	BSC.interf.cmde_mask = _CM(FR_NO_CMDE)
-				| _CM(FR_RAM_READ)
-				| _CM(FR_RAM_WRITE)
-				| _CM(FR_EEP_READ)
-				| _CM(FR_EEP_WRITE)
-				| _CM(FR_FLH_READ)
-				| _CM(FR_FLH_WRITE)
-				| _CM(FR_SPI_READ)
-				| _CM(FR_SPI_WRITE)
-				| _CM(FR_WAIT)
-				| _CM(FR_CONTAINER);
+	BSC.interf.cmde_mask = FR_MASK_BSC;
 	BSC.interf.queue = &BSC.in_fifo;
 	DPT_register(&BSC.interf);
 
@@ -423,6 +414,11 @@ void BSC_init(void)
 
 void BSC_run(void)
 {
+	// nothing to do until a frame is received or the wait is over
+	if ( !DPT_ready(&BSC.interf) ) {
+		return;
+	}
+
 	// incoming frames handling
 	(void)PT_SCHEDULE(BSC_in(&BSC.in_pt));
 
@@ -434,4 +430,15 @@ void BSC_run(void)
 		// unlock the dispatcher
 		DPT_unlock(&BSC.interf);
 	}
+
+	// if a wait command is running
+	if ( BSC.time_out ) {
+		// the responses are sent at its end
+		DPT_wake_at(&BSC.interf, BSC.time_out);
+	}
+	// else if a frame handling or response sending is running
+	else if ( BSC.is_running || FIFO_full(&BSC.out_fifo) ) {
+		// keep on polling
+		DPT_wake(&BSC.interf);
+	}
 }
@@ -23,6 +23,10 @@
 // public defines
 //
 
+#ifndef BSC_NB_IN
+# define BSC_NB_IN	3	// number of incoming frames (one more is kept during a wait)
+#endif
+
 
 //----------------------------------------
 // public types
@@ -0,0 +1,71 @@
+// cycles per frame delivered by DPT_dispatch()
+// 12 registered channels, NSUB of them subscribed to the frame command
+
+#include DPT_C
+
+#include <stdio.h>
+
+#ifndef NSUB
+# define NSUB	1
+#endif
+
+#define CMDE	0x10	// dispatched command
+#define OTHER	0x20	// command every channel subscribes to
+
+static dpt_interface_t itf[12];
+static fifo_t queue[12];
+#ifdef FR_MASK_SIZE
+static u8 mask[12][FR_MASK_SIZE];	// command filters in flash
+#endif
+
+int main(void)
+{
+	unsigned long long t0, best = ~0ULL;
+	frame_t* fr;
+	int i, n, b;
+
+	DPT_init();
+	for ( i = 0; i < 12; i++ ) {
+		int sub = (i * NSUB) / 12 != ((i + 1) * NSUB) / 12;
+
+		itf[i].channel = i;
+		itf[i].queue = &queue[i];
+#ifdef FR_MASK_SIZE
+		mask[i][OTHER >> 3] |= 1 << (OTHER & 7);
+		if ( sub )
+			mask[i][CMDE >> 3] |= 1 << (CMDE & 7);
+		itf[i].cmde_mask = mask[i];
+#else
+		itf[i].cmde_mask = (1ULL << OTHER) | (sub ? (1ULL << CMDE) : 0);
+#endif
+		DPT_register(&itf[i]);
+	}
+
+#ifdef DPT_SLOT
+	// the frames are reference counted pool slots
+	fr = DPT_alloc();
+#else
+	static frame_t f;
+	fr = &f;
+#endif
+	memset(fr, 0, sizeof(*fr));
+	fr->cmde = CMDE;
+
+	for ( b = 0; b < 200; b++ ) {
+		t0 = __builtin_ia32_rdtsc();
+		for ( n = 0; n < 1000; n++ ) {
+#ifdef DPT_SLOT
+			DPT_SLOT(fr)->ref = 1;
+#endif
+			DPT_dispatch(fr);
+			__asm__ volatile("" ::: "memory");
+		}
+		t0 = __builtin_ia32_rdtsc() - t0;
+		if ( t0 < best )
+			best = t0;
+	}
+
+	printf("%s nsub=%d : %.1f cycles/frame\n", REV, NSUB, best / 1000.0);
+
+	return 0;
+}
@@ -0,0 +1,130 @@
+// host drivers for the main loop benchmark
+// a lonely node : every bus transfer fails with no slave,
+// the eeprom and the sdcard read as erased
+
+#include "type_def.h"
+#include "utils/fifo.h"
+#include "drivers/twi.h"
+#include "drivers/spi.h"
+#include "drivers/sleep.h"
+
+#include <string.h>
+#include <time.h>
+
+volatile unsigned char SREG;
+volatile unsigned char PORTB, DDRB, PINB, PORTC, DDRC, PINC, PORTD, DDRD, PIND;
+volatile unsigned char UDR0, UCSR0A, UCSR0B, UCSR0C, UBRR0H, UBRR0L;
+
+void cli(void) {}
+void sei(void) {}
+
+// the time is updated once per main loop pass, like the timer interrupt would
+static u32 time_now;
+
+void time_update(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	time_now = (u32)(ts.tv_sec * 100000ULL + ts.tv_nsec / 10000);
+}
+
+u32 TIME_get(void) { return time_now; }
+void TIME_set_incr(u32 incr) { (void)incr; }
+
+void FIFO_init(fifo_t* f, void* buf, u8 nb, u8 elem_size)
+{
+	f->nb = nb;
+	f->lng = 0;
+	f->elem_size = elem_size;
+	f->buf = buf;
+	f->end = f->buf + nb * elem_size;
+	f->in = f->buf;
+	f->out = f->buf;
+}
+
+u8 FIFO_put(fifo_t* f, void* elem)
+{
+	if ( f->lng == f->nb )
+		return KO;
+	memcpy(f->in, elem, f->elem_size);
+	f->in += f->elem_size;
+	if ( f->in == f->end )
+		f->in = f->buf;
+	f->lng++;
+	return OK;
+}
+
+u8 FIFO_get(fifo_t* f, void* elem)
+{
+	if ( f->lng == 0 )
+		return KO;
+	memcpy(elem, f->out, f->elem_size);
+	f->out += f->elem_size;
+	if ( f->out == f->end )
+		f->out = f->buf;
+	f->lng--;
+	return OK;
+}
+
+u8 FIFO_unget(fifo_t* f, void* elem)
+{
+	if ( f->lng == f->nb )
+		return KO;
+	if ( f->out == f->buf )
+		f->out = f->end;
+	f->out -= f->elem_size;
+	memcpy(f->out, elem, f->elem_size);
+	f->lng++;
+	return OK;
+}
+
+u8 FIFO_full(fifo_t* f) { return f->lng; }
+u8 FIFO_free(fifo_t* f) { return f->nb - f->lng; }
+
+// the pending transfer ends with no slave at the end of the pass
+static twi_call_back_t twi_cb;
+static void* twi_misc;
+static u8 twi_pending;
+
+void twi_poll(void)
+{
+	if ( twi_pending ) {
+		twi_pending = 0;
+		twi_cb(TWI_NO_SL, 0, twi_misc);
+	}
+}
+
+void TWI_init(twi_call_back_t cb, void* misc) { twi_cb = cb; twi_misc = misc; }
+u8 TWI_ms_tx(u8 adr, u8 len, u8* data) { (void)adr; (void)len; (void)data; twi_pending = 1; return OK; }
+u8 TWI_ms_rx(u8 adr, u8 len, u8* data) { (void)adr; (void)len; (void)data; twi_pending = 1; return OK; }
+u8 TWI_sl_tx(u8 len, u8* data) { (void)len; (void)data; return OK; }
+u8 TWI_sl_rx(u8 len, u8* data) { (void)len; (void)data; return OK; }
+void TWI_stop(void) {}
+void TWI_set_sl_addr(u8 addr) { (void)addr; }
+void TWI_gen_call(u8 flag) { (void)flag; }
+
+static u8 eep[1024];
+
+__attribute__((constructor)) static void eep_erase(void) { memset(eep, 0xff, sizeof(eep)); }
+
+void EEP_init(void) {}
+u8 EEP_read(u16 addr, u8* data, u16 len) { memcpy(data, eep + addr, len); return OK; }
+u8 EEP_write(u16 addr, u8* data, u16 len) { memcpy(eep + addr, data, len); return OK; }
+u8 EEP_is_fini(void) { return OK; }
+
+u8 SD_init(void) { return OK; }
+u8 SD_read(u64 addr, u8* data, u16 len) { (void)addr; memset(data, 0xff, len); return OK; }
+u8 SD_write(u64 addr, u8* data, u16 len) { (void)addr; (void)data; (void)len; return OK; }
+u8 SD_is_fini(void) { return OK; }
+
+void SPI_init(spi_mode_t mode, spi_polarity_t polarity, spi_order_t order, spi_div_t div) { (void)mode; (void)polarity; (void)order; (void)div; }
+u8 SPI_master(u8* tx, u8 tx_len, u8* rx, u8 rx_len) { (void)tx; (void)tx_len; (void)rx; (void)rx_len; return OK; }
+u8 SPI_is_fini(void) { return OK; }
+u8 SPI_is_ok(void) { return OK; }
+
+void SLP_init(void) {}
+slp_t SLP_register(void) { return 0; }
+u8 SLP_request(slp_t slp) { (void)slp; return OK; }
+
+void RS_init(u8 baud) { (void)baud; }
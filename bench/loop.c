@@ -0,0 +1,75 @@
+// cycles per pass of the main loop of a node with the whole library
+// without bus traffic, after one second of start-up traffic
+
+#include "dispatcher.h"
+#include "alive.h"
+#include "basic.h"
+#include "common.h"
+#include "cpu.h"
+#include "dna.h"
+#include "log.h"
+#include "nat.h"
+#include "routing_tables.h"
+#include "time_sync.h"
+
+#include "utils/time.h"
+
+#include <stdio.h>
+
+extern void time_update(void);
+extern void twi_poll(void);
+
+int main(void)
+{
+	unsigned long long t0, sum = 0, best = ~0ULL, n = 0, passes = 0;
+	u32 start, end;
+
+	DPT_init();
+	BSC_init();
+	CMN_init();
+	CPU_init();
+	DNA_init(DNA_BS);
+	LOG_init();
+	NAT_init();
+	ROUT_init();
+	TSN_init();
+	ALV_init();
+
+	time_update();
+	start = TIME_get();
+	end = start + 6 * TIME_1_SEC;
+
+	while ( TIME_get() < end ) {
+		time_update();
+
+		t0 = __builtin_ia32_rdtsc();
+		DPT_run();
+		BSC_run();
+		CMN_run();
+		CPU_run();
+		DNA_run();
+		LOG_run();
+		NAT_run();
+		ROUT_run();
+		TSN_run();
+		ALV_run();
+		twi_poll();
+		t0 = __builtin_ia32_rdtsc() - t0;
+
+		if ( TIME_get() < start + TIME_1_SEC )
+			continue;
+
+		passes++;
+		sum += t0;
+		if ( ++n == 1000 ) {
+			if ( sum < best )
+				best = sum;
+			sum = 0;
+			n = 0;
+		}
+	}
+
+	printf("%s : %.1f cycles per idle main loop pass (best of 1000 passes), %llu passes per second\n", REV, best / 1000.0, passes / 5);
+
+	return 0;
+}
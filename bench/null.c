@@ -0,0 +1,40 @@
+// no-op drivers for the dispatcher benchmarks
+// the queues never fill up so every frame is delivered
+
+#include "type_def.h"
+#include "utils/fifo.h"
+#include "drivers/twi.h"
+
+#include "routing_tables.h"
+
+volatile unsigned char SREG;
+volatile unsigned char PORTB, DDRB, PINB, PORTC, DDRC, PINC, PORTD, DDRD, PIND;
+volatile unsigned char UDR0, UCSR0A, UCSR0B, UCSR0C, UBRR0H, UBRR0L;
+
+void cli(void) {}
+void sei(void) {}
+
+u32 TIME_get(void) { return 0; }
+void TIME_set_incr(u32 incr) { (void)incr; }
+
+void FIFO_init(fifo_t* f, void* buf, u8 nb, u8 elem_size) { (void)f; (void)buf; (void)nb; (void)elem_size; }
+u8 FIFO_put(fifo_t* f, void* elem) { (void)f; (void)elem; return OK; }
+u8 FIFO_get(fifo_t* f, void* elem) { (void)f; (void)elem; return KO; }
+u8 FIFO_unget(fifo_t* f, void* elem) { (void)f; (void)elem; return KO; }
+u8 FIFO_full(fifo_t* f) { (void)f; return 0; }
+u8 FIFO_free(fifo_t* f) { (void)f; return 1; }
+
+void TWI_init(twi_call_back_t cb, void* misc) { (void)cb; (void)misc; }
+u8 TWI_ms_tx(u8 adr, u8 len, u8* data) { (void)adr; (void)len; (void)data; return OK; }
+u8 TWI_ms_rx(u8 adr, u8 len, u8* data) { (void)adr; (void)len; (void)data; return OK; }
+u8 TWI_sl_tx(u8 len, u8* data) { (void)len; (void)data; return OK; }
+u8 TWI_sl_rx(u8 len, u8* data) { (void)len; (void)data; return OK; }
+void TWI_stop(void) {}
+void TWI_set_sl_addr(u8 addr) { (void)addr; }
+void TWI_gen_call(u8 flag) { (void)flag; }
+
+// the routing table is not linked
+void ROUT_route(const u8 addr, u8 list[MAX_ROUTES], u8* list_len) { (void)addr; (void)list; *list_len = 0; }
+void ROUT_latency(const u8 addr, u32 latency) { (void)addr; (void)latency; }
+void ROUT_dead(const u8 addr) { (void)addr; }
+void ROUT_alive(const u8 addr) { (void)addr; }
@@ -0,0 +1,68 @@
+// cycles per ROUT_route() lookup against the former linear scan of the table
+// one route per virtual address, the even virtual addresses only
+
+#include ROUT_C
+
+#include <stdio.h>
+
+static volatile u8 sink;
+
+// the lookup before the sorted table, on the same pairs
+static __attribute__((noinline)) void LIN_route(const u8 addr, u8 list[MAX_ROUTES], u8* list_len)
+{
+	u8 i, j = 0;
+
+	for ( i = 0; i < ROUT.nb_pairs; i++ ) {
+		if ( ROUT.table[i].virtual_addr == addr && j < *list_len ) {
+			list[j] = ROUT.table[i].routed_addr;
+			j++;
+		}
+	}
+	*list_len = j;
+}
+
+#define BENCH(res, fn, base)	do {							\
+	best = ~0ULL;												\
+	for ( b = 0; b < 300; b++ ) {								\
+		t0 = __builtin_ia32_rdtsc();							\
+		for ( n = 0; n < 1000; n++ ) {							\
+			len = MAX_ROUTES;									\
+			fn((u8)((base) + (n % nb) * 2), list, &len);		\
+			sink = len;											\
+		}														\
+		t0 = __builtin_ia32_rdtsc() - t0;						\
+		if ( t0 < best )										\
+			best = t0;											\
+	}															\
+	res = best / 1000.0;										\
+} while (0)
+
+int main(void)
+{
+	static const int sizes[] = { 8, 16, 32, 64, 128 };
+	unsigned long long t0, best;
+	double lin_hit, lin_miss, bis_hit, bis_miss;
+	u8 list[MAX_ROUTES], len;
+	int s, i, n, b, nb;
+
+	for ( s = 0; s < 5 && sizes[s] <= ROUT_NB_PAIRS; s++ ) {
+		nb = sizes[s];
+		memset(&ROUT, 0, sizeof(ROUT));
+		for ( i = 0; i < nb; i++ ) {
+#ifdef FR_ROUT_ALL
+			ROUT_add(0x10 + 2 * i, 0x80 + (i & 0x3f), FR_ROUT_ALL);
+#else
+			ROUT_add(0x10 + 2 * i, 0x80 + (i & 0x3f));
+#endif
+		}
+
+		BENCH(lin_hit, LIN_route, 0x10);
+		BENCH(lin_miss, LIN_route, 0x11);
+		BENCH(bis_hit, ROUT_route, 0x10);
+		BENCH(bis_miss, ROUT_route, 0x11);
+
+		printf("%s %3d pairs : linear hit %6.1f miss %6.1f | bisection hit %6.1f miss %6.1f\n", REV, nb, lin_hit, lin_miss, bis_hit, bis_miss);
+	}
+
+	return 0;
+}
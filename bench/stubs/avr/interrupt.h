@@ -0,0 +1,10 @@
+// host stand-in of avr-libc interrupt.h
+#ifndef __AVR_INTERRUPT_H__
+# define __AVR_INTERRUPT_H__
+
+extern void cli(void);
+extern void sei(void);
+
+# define ISR(vector)	void vector(void)
+
+#endif
@@ -0,0 +1,23 @@
+// host stand-in of avr-libc io.h (atmega328p registers used by scalp)
+#ifndef __AVR_IO_H__
+# define __AVR_IO_H__
+
+extern volatile unsigned char SREG;
+extern volatile unsigned char PORTB, DDRB, PINB, PORTC, DDRC, PINC, PORTD, DDRD, PIND;
+extern volatile unsigned char UDR0, UCSR0A, UCSR0B, UCSR0C, UBRR0H, UBRR0L;
+
+# define _BV(bit)	(1 << (bit))
+
+# define PB4	4
+# define PB5	5
+# define PD5	5
+
+# define U2X0	1
+# define UCSZ00	1
+# define UCSZ01	2
+# define TXEN0	3
+# define RXEN0	4
+# define UDRIE0	5
+# define RXCIE0	7
+
+#endif
@@ -0,0 +1,13 @@
+// host stand-in of avr-libc pgmspace.h : the flash is plain memory
+#ifndef __AVR_PGMSPACE_H__
+# define __AVR_PGMSPACE_H__
+
+# include <string.h>
+# include <stdint.h>
+
+# define PROGMEM
+# define pgm_read_byte(addr)	(*(const uint8_t*)(uintptr_t)(addr))
+# define pgm_read_word(addr)	(*(const uint16_t*)(uintptr_t)(addr))
+# define memcpy_P(dst, src, len)	memcpy((dst), (src), (len))
+
+#endif
@@ -0,0 +1,12 @@
+// host stand-in of nanoK eeprom.h
+#ifndef __EEPROM_H__
+# define __EEPROM_H__
+
+# include "type_def.h"
+
+extern void EEP_init(void);
+extern u8 EEP_read(u16 addr, u8* data, u16 len);
+extern u8 EEP_write(u16 addr, u8* data, u16 len);
+extern u8 EEP_is_fini(void);
+
+#endif
@@ -0,0 +1,9 @@
+// host stand-in of nanoK rs.h
+#ifndef __RS_H__
+# define __RS_H__
+
+# include "type_def.h"
+
+extern void RS_init(u8 baud);
+
+#endif
@@ -0,0 +1,13 @@
+// host stand-in of nanoK sleep.h
+#ifndef __SLEEP_H__
+# define __SLEEP_H__
+
+# include "type_def.h"
+
+typedef u8 slp_t;
+
+extern void SLP_init(void);
+extern slp_t SLP_register(void);
+extern u8 SLP_request(slp_t slp);
+
+#endif
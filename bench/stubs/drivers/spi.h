@@ -0,0 +1,17 @@
+// host stand-in of nanoK spi.h
+#ifndef __SPI_H__
+# define __SPI_H__
+
+# include "type_def.h"
+
+typedef enum { SPI_MASTER, SPI_SLAVE } spi_mode_t;
+typedef enum { SPI_ZERO, SPI_ONE, SPI_TWO, SPI_THREE } spi_polarity_t;
+typedef enum { SPI_MSB, SPI_LSB } spi_order_t;
+typedef enum { SPI_DIV_2, SPI_DIV_4, SPI_DIV_8, SPI_DIV_16, SPI_DIV_32, SPI_DIV_64, SPI_DIV_128 } spi_div_t;
+
+extern void SPI_init(spi_mode_t mode, spi_polarity_t polarity, spi_order_t order, spi_div_t div);
+extern u8 SPI_master(u8* tx, u8 tx_len, u8* rx, u8 rx_len);
+extern u8 SPI_is_fini(void);
+extern u8 SPI_is_ok(void);
+
+#endif
@@ -0,0 +1,32 @@
+// host stand-in of nanoK twi.h
+#ifndef __TWI_H__
+# define __TWI_H__
+
+# include "type_def.h"
+
+typedef enum {
+	TWI_NONE,
+	TWI_NO_SL,
+	TWI_MS_RX_END,
+	TWI_MS_TX_END,
+	TWI_SL_RX_BEGIN,
+	TWI_SL_RX_END,
+	TWI_SL_TX_BEGIN,
+	TWI_SL_TX_END,
+	TWI_GENCALL_BEGIN,
+	TWI_GENCALL_END,
+	TWI_ERROR,
+} twi_state_t;
+
+typedef void (*twi_call_back_t)(twi_state_t state, u8 nb_data, void* misc);
+
+extern void TWI_init(twi_call_back_t call_back, void* misc);
+extern u8 TWI_ms_tx(u8 adr, u8 len, u8* data);
+extern u8 TWI_ms_rx(u8 adr, u8 len, u8* data);
+extern u8 TWI_sl_tx(u8 len, u8* data);
+extern u8 TWI_sl_rx(u8 len, u8* data);
+extern void TWI_stop(void);
+extern void TWI_set_sl_addr(u8 addr);
+extern void TWI_gen_call(u8 flag);
+
+#endif
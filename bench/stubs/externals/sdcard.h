@@ -0,0 +1,12 @@
+// host stand-in of nanoK sdcard.h
+#ifndef __SDCARD_H__
+# define __SDCARD_H__
+
+# include "type_def.h"
+
+extern u8 SD_init(void);
+extern u8 SD_read(u64 addr, u8* data, u16 len);
+extern u8 SD_write(u64 addr, u8* data, u16 len);
+extern u8 SD_is_fini(void);
+
+#endif
@@ -0,0 +1,11 @@
+// host stand-in of nanoK w5100.h
+#ifndef __W5100_H__
+# define __W5100_H__
+
+# include "type_def.h"
+
+extern void W5100_init(void);
+extern u8 W5100_rx(u16 port, u8* data, u16 len);
+extern u8 W5100_tx(u32 ip, u16 port, u8* data, u16 len);
+
+#endif
@@ -0,0 +1,15 @@
+// host stand-in of avr-libc crc16.h
+#ifndef __UTIL_CRC16_H__
+# define __UTIL_CRC16_H__
+
+# include <stdint.h>
+
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+	data ^= crc & 0xff;
+	data ^= data << 4;
+
+	return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+#endif
@@ -0,0 +1,24 @@
+// host stand-in of nanoK fifo.h
+#ifndef __FIFO_H__
+# define __FIFO_H__
+
+# include "type_def.h"
+
+typedef struct {
+	u8 nb;			// capacity
+	u8 lng;			// number of elements
+	u8 elem_size;	// element size
+	u8* buf;		// first element
+	u8* end;		// end of the buffer
+	u8* in;			// next element written
+	u8* out;		// next element read
+} fifo_t;
+
+extern void FIFO_init(fifo_t* f, void* buf, u8 nb, u8 elem_size);
+extern u8 FIFO_put(fifo_t* f, void* elem);
+extern u8 FIFO_get(fifo_t* f, void* elem);
+extern u8 FIFO_unget(fifo_t* f, void* elem);
+extern u8 FIFO_full(fifo_t* f);
+extern u8 FIFO_free(fifo_t* f);
+
+#endif
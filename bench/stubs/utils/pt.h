@@ -0,0 +1,38 @@
+// host stand-in of nanoK pt.h (protothreads with gcc labels as values)
+#ifndef __PT_H__
+# define __PT_H__
+
+# include <stddef.h>
+
+typedef void* lc_t;
+
+typedef struct {
+	lc_t lc;
+} pt_t;
+
+# define LC_INIT(s)		(s) = NULL
+# define LC_RESUME(s)	do { if ( (s) != NULL ) goto *(s); } while (0)
+# define LC_CONCAT2(s1, s2)	s1##s2
+# define LC_CONCAT(s1, s2)	LC_CONCAT2(s1, s2)
+# define LC_SET(s)		do { LC_CONCAT(LC_LABEL, __LINE__): (s) = &&LC_CONCAT(LC_LABEL, __LINE__); } while (0)
+# define LC_END(s)
+
+# define PT_WAITING	0
+# define PT_YIELDED	1
+# define PT_EXITED	2
+# define PT_ENDED	3
+
+# define PT_INIT(pt)			LC_INIT((pt)->lc)
+# define PT_THREAD(name_args)	char name_args
+# define PT_BEGIN(pt)			{ char PT_YIELD_FLAG = 1; (void)PT_YIELD_FLAG; LC_RESUME((pt)->lc)
+# define PT_END(pt)				LC_END((pt)->lc); PT_YIELD_FLAG = 0; PT_INIT(pt); return PT_ENDED; }
+# define PT_WAIT_UNTIL(pt, cond)	do { LC_SET((pt)->lc); if ( !(cond) ) return PT_WAITING; } while (0)
+# define PT_WAIT_WHILE(pt, cond)	PT_WAIT_UNTIL((pt), !(cond))
+# define PT_WAIT_THREAD(pt, thread)	PT_WAIT_WHILE((pt), PT_SCHEDULE(thread))
+# define PT_SPAWN(pt, child, thread)	do { PT_INIT((child)); PT_WAIT_THREAD((pt), (thread)); } while (0)
+# define PT_RESTART(pt)			do { PT_INIT(pt); return PT_WAITING; } while (0)
+# define PT_EXIT(pt)			do { PT_INIT(pt); return PT_EXITED; } while (0)
+# define PT_SCHEDULE(f)			((f) < PT_EXITED)
+# define PT_YIELD(pt)			do { PT_YIELD_FLAG = 0; LC_SET((pt)->lc); if ( PT_YIELD_FLAG == 0 ) return PT_YIELDED; } while (0)
+
+#endif
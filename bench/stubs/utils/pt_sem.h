@@ -0,0 +1,15 @@
+// host stand-in of nanoK pt_sem.h
+#ifndef __PT_SEM_H__
+# define __PT_SEM_H__
+
+# include "utils/pt.h"
+
+typedef struct {
+	unsigned int count;
+} pt_sem_t;
+
+# define PT_SEM_INIT(s, c)	(s)->count = (c)
+# define PT_SEM_WAIT(pt, s)	do { PT_WAIT_UNTIL(pt, (s)->count > 0); --(s)->count; } while (0)
+# define PT_SEM_SIGNAL(pt, s)	++(s)->count
+
+#endif
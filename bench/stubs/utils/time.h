@@ -0,0 +1,15 @@
+// host stand-in of nanoK time.h (10 us resolution)
+#ifndef __TIME_H__
+# define __TIME_H__
+
+# include "type_def.h"
+
+# define TIME_MAX		((u32)0xffffffff)
+# define TIME_1_MSEC	((u32)100)
+# define TIME_1_SEC		((u32)100000)
+
+extern u32 TIME_get(void);
+extern void TIME_set(u32 time);
+extern void TIME_set_incr(u32 incr);
+
+#endif
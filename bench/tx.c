@@ -0,0 +1,50 @@
+// cycles per frame queued by DPT_tx() then taken by the appli thread
+// every channel is registered, the sender is the lowest priority one
+
+#include DPT_C
+
+#include <stdio.h>
+
+#define OTHER	0x20	// command every channel subscribes to
+
+static dpt_interface_t itf[DPT_CHAN_NB];
+static fifo_t queue[DPT_CHAN_NB];
+static u8 mask[DPT_CHAN_NB][FR_MASK_SIZE];
+
+int main(void)
+{
+	unsigned long long t0, best = ~0ULL;
+	frame_t f, *fr;
+	int i, n, b;
+
+	DPT_init();
+	for ( i = 0; i < DPT_CHAN_NB; i++ ) {
+		itf[i].channel = i;
+		itf[i].queue = &queue[i];
+		mask[i][OTHER >> 3] |= 1 << (OTHER & 7);
+		itf[i].cmde_mask = mask[i];
+		DPT_register(&itf[i]);
+	}
+
+	memset(&f, 0, sizeof(f));
+	f.cmde = 0x10;
+	f.dest = 0x20;
+	f.resp = 1;
+
+	for ( b = 0; b < 500; b++ ) {
+		t0 = __builtin_ia32_rdtsc();
+		for ( n = 0; n < 1000; n++ ) {
+			DPT_tx(&itf[DPT_CHAN_NB - 1], &f);
+			fr = DPT_tx_get();
+			DPT_free(fr);
+			__asm__ volatile("" ::: "memory");
+		}
+		t0 = __builtin_ia32_rdtsc() - t0;
+		if ( t0 < best )
+			best = t0;
+	}
+
+	printf("%s chan_nb=%d : %.1f cycles/frame\n", REV, DPT_CHAN_NB, best / 1000.0);
+
+	return 0;
+}
@@ -35,7 +35,6 @@
 //
 
 #define OUT_SIZE	3
-#define IN_SIZE		1
 
 #define LED_PORT		PORTB
 #define LED_DDR			DDRB
@@ -74,7 +73,7 @@ static struct {
 
 	// incoming fifo
 	fifo_t in_fifo;
-	frame_t in_buf[IN_SIZE];
+	frame_t* in_buf[CMN_NB_IN];
 
 	frame_t fr;					// a buffer frame
 
@@ -117,7 +116,7 @@ static PT_THREAD( CMN_in(pt_t* pt) )
 	PT_BEGIN(pt);
 
 	// wait incoming frame
-	PT_WAIT_UNTIL(pt, FIFO_get(&CMN.in_fifo, &CMN.fr));
+	PT_WAIT_UNTIL(pt, DPT_rx(&CMN.interf, &CMN.fr));
 
 	// if frame is a response
 	if (CMN.fr.resp) {
@@ -181,6 +180,27 @@ static PT_THREAD( CMN_in(pt_t* pt) )
 		}
 		break;
 
+	case FR_DPT_STATS:
+		// read the dispatcher statistics
+		if ( KO == DPT_stats(&CMN.fr) ) {
+			CMN.fr.error = 1;
+		}
+		break;
+
+	case FR_DPT_SHAPE:
+		// set or get a channel bandwidth shaping
+		if ( KO == DPT_shape(&CMN.fr) ) {
+			CMN.fr.error = 1;
+		}
+		break;
+
+	case FR_DPT_GROUP:
+		// join, leave or get the multicast groups
+		if ( KO == DPT_group(&CMN.fr) ) {
+			CMN.fr.error = 1;
+		}
+		break;
+
 	case FR_LED_CMD:
 		switch (CMN.fr.argv[0]) {
 		case FR_LED_ALIVE:	// green led
@@ -305,7 +325,7 @@ void CMN_init(void)
 {
 	// fifo init
 	FIFO_init(&CMN.out_fifo, &CMN.out_buf, OUT_SIZE, sizeof(CMN.out_buf[0]));	
-	FIFO_init(&CMN.in_fifo, &CMN.in_buf, IN_SIZE, sizeof(CMN.in_buf[0]));	
+	FIFO_init(&CMN.in_fifo, &CMN.in_buf, CMN_NB_IN, sizeof(CMN.in_buf[0]));	
 
 	// thread context init
 	PT_INIT(&CMN.out_pt);
@@ -321,7 +341,7 @@ void CMN_init(void)
 
 	// register own call-back for specific commands
 	CMN.interf.channel = 3;
-	CMN.interf.cmde_mask = _CM(FR_STATE) | _CM(FR_TIME_GET) | _CM(FR_MUX_RESET) | _CM(FR_LED_CMD);
+	CMN.interf.cmde_mask = FR_MASK_CMN;
 	CMN.interf.queue = &CMN.in_fifo;
 	DPT_register(&CMN.interf);
 
@@ -337,6 +357,11 @@ void CMN_init(void)
 // common module run method
 void CMN_run(void)
 {
+	// nothing to do until a command or the next blink time
+	if ( !DPT_ready(&CMN.interf) ) {
+		return;
+	}
+
 	// handle command if any
 	(void)PT_SCHEDULE(CMN_in(&CMN.in_pt));
 
@@ -348,7 +373,12 @@ void CMN_run(void)
 		// unlock the dispatcher
 		DPT_unlock(&CMN.interf);
 	}
+	else {
+		// some responses are still to be sent
+		DPT_wake(&CMN.interf);
+	}
 
 	// blink the leds
 	(void)PT_SCHEDULE(CMN_blink(&CMN.blink_pt));
+	DPT_wake_at(&CMN.interf, CMN.time);
 }
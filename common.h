@@ -20,6 +20,10 @@
 // public defines
 //
 
+# ifndef CMN_NB_IN
+#  define CMN_NB_IN	1	// incoming frames buffer size
+# endif
+
 typedef enum {
 	READY,
 	WAIT_TAKE_OFF,
@@ -156,7 +156,7 @@ void CPU_init(void)
 	// register to dispatcher
 	CPU.interf.channel = 10;
 	CPU.interf.queue = NULL;
-	CPU.interf.cmde_mask = 0;
+	CPU.interf.cmde_mask = NULL;
 	DPT_register(&CPU.interf);
 
 	PT_INIT(&CPU.pt);
@@ -21,37 +21,120 @@
 
 // design
 //
-// the software emission fifo is one frame deep only
-// and is filled by the applications upon locking their channel.
-// a thread is in charge of routing the frame placed in this fifo.
+// each channel owns a small emission queue
+// filled by its application without waiting for the others.
+// a thread is in charge of routing the frames placed in these queues,
+// always taking the one of the highest priority channel first.
+// the frames for the local node skip the queues and the routing
+// and are given to the receivers when sent,
+// unless a frame of higher priority is still queued.
 // if enough place is available in the emission fifoes,
 // the frame is routed and place in these fifoes,
-// else it is re-queued.
+// else it is lost.
 //
 // on reception, the frame is enqueued in a reception fifo.
 // this fifo is proceeded by a thread.
+// the frames received or built under interrupt (twi call-back)
+// go through their own ring, read only by the in thread.
+// it is written by the call-back and, with the interrupts disabled,
+// by the out thread for the failed responses of an abandoned transfer,
+// so the twi reception never waits for the threads.
+//
+// the frames are stored once in a pool of slots shared
+// by the dispatcher and the applications.
+// the fifoes only carry references (frame_t*) on these slots
+// and each slot counts the references held on it.
+// so a frame is copied once when it is sent,
+// and giving it to several receivers only takes more references.
+// the slot is freed when its last reference is released.
+//
+// on the twi bus, the frames for the same node are sent in a single burst :
+//   [orig] { [size] [t_id] [cmde] [status] [argv...] }*
+// the destination is given by the I2C address
+// and the trailing null arguments of a frame are not sent.
+// the receiver splits the burst and gets the missing arguments back
+// by zeroing them.
+// the len field is not used for that purpose
+// because some commands (I2C, SPI) give it another meaning.
+//
+// the command filters are bitmaps of the 256 commands
+// generated in flash by frame.py.
+// each frame is tested in the filter of the channels
+// subscribed to at least one command.
+// with DPT_ENABLE_FANOUT, the first commands, used by the system modules,
+// get a table giving their subscribed channels, built at registration,
+// and only the other ones are tested in the filters.
+//
+// the requests sent by the applications are recorded
+// in a transaction table until their response is received.
+// a response is only given to the channel which sent the request
+// if it comes from the node the request was routed to.
+// the frames not found in the table are given to every subscriber.
+// a request sent as a call keeps its response in the table
+// until the application takes it, so several calls can be in flight.
+// if no response is received before the deadline,
+// a call gets a time-out response instead
+// and the other requests are forgotten.
+//
+// the frames to send on the twi bus wait in an out queue
+// ordered by the priority of their source channel.
+// each time a frame is taken, the frames left behind get older
+// and an older frame gains one priority level,
+// so the low priority channels are not starved.
+//
+// the frames for a multicast group are sent with a general call
+// like the broadcast ones, and the general call bursts
+// begin with their destination :
+//   [dest] [orig] { [size] [t_id] [cmde] [status] [argv...] }*
+// the nodes which didn't join the group drop the burst
+// before the frames reach the dispatcher.
+//
+// with DPT_ENABLE_DUP, a request received several times (several routes to the node,
+// twi transfer retried after a lost acknowledge) is only dispatched once :
+// the origin, transaction id and command of the last requests
+// are kept for a while and the copies received meanwhile are dropped.
+// a request sent again by an application gets a new transaction id
+// so it is not a copy and is dispatched again.
+//
+// the result of each twi transfer is reported to the routing tables
+// so they can route around the nodes no more responding.
+//
+// with DPT_ENABLE_SHAPE, the bandwidth of a channel on the twi bus can be limited
+// by a token bucket refilled at a regular period.
+// a frame for another node is refused while the bucket is empty
+// and the channel is woken when a token is back.
+//
+// the dispatcher also keeps the run queue of the applications.
+// a channel is ready when a frame is queued for it,
+// when its emission queue gets room again or a frame could not be sent,
+// when its deadline is elapsed or when it is explicitly woken.
+// so the applications with nothing to do can skip their threads.
 //
 //
 // nice-to-have
 //
 // routing tables to completely abstract the node destination
 // from the application point of view.
-// node disconnection tolerance by dynamic re-routing
 //
 //   /A\    /B\    /C\        /Y\    /Z\
 //   \ /    \ /    \ / ...... \ /    \ /
 //    |      |      |          |      |
 // ---+------+------+---+------+------+---------- soft
-//           appli fifo |  in fifo ^
+//      channel queues  |  in fifo ^
 //                    /   \        |
 //                    \   /
-//             out fifo |
+//            out queue |
 //            ----------+---------- twi
 //
 
 #include "dispatcher.h"
 
 #include "routing_tables.h"
+#include "basic.h"			// BSC_NB_IN
+#include "common.h"			// CMN_NB_IN
+#include "dna.h"			// DNA_NB_IN
+#include "log.h"			// LOG_NB_IN
+#include "nat.h"			// NAT_TWI_IN_SIZE
 
 #include "drivers/twi.h"
 
@@ -60,17 +143,176 @@
 #include "utils/pt.h"
 
 #include <avr/interrupt.h>	// cli()
+#include <avr/pgmspace.h>	// pgm_read_byte()
 
 #include <string.h>	// memset
+#include <stdlib.h>	// rand, srand
 
 
 //----------------------------------------
 // private defines
 //
 
-#define NB_IN_FRAMES			(MAX_ROUTES / 2)
-#define NB_OUT_FRAMES			(MAX_ROUTES / 2)
-#define NB_APPLI_FRAMES			1
+// frames the library modules can hold in their reception queues
+// plus the one kept by the basic module during a wait
+#define DPT_MOD_FRAMES			(BSC_NB_IN + 1 + CMN_NB_IN + DNA_NB_IN + LOG_NB_IN + NAT_TWI_IN_SIZE + ROUT_NB_RX)
+#ifndef DPT_SUB_FRAMES
+# define DPT_SUB_FRAMES			(DPT_MOD_FRAMES + DPT_APP_FRAMES)	// frames held out of the dispatcher
+#endif
+
+#ifndef NB_IN_FRAMES
+# define NB_IN_FRAMES			3		// in fifo size
+#endif
+#define NB_RX_FRAMES			4		// twi reception ring size (one entry is kept empty)
+#ifndef NB_OUT_FRAMES
+# define NB_OUT_FRAMES			5		// out queue size
+#endif
+#define NB_TX_FRAMES			2		// frames each channel can queue for emission
+#ifndef NB_POOL_FRAMES
+# define NB_POOL_FRAMES			(DPT_SUB_FRAMES + NB_IN_FRAMES + NB_OUT_FRAMES + NB_RX_FRAMES - 1)	// frames shared by the dispatcher and the applications
+#endif
+
+#define DPT_AGE_MAX				0xff	// out queue age saturation
+
+#define NB_DUP					8		// last requests recorded to drop their copies
+#ifndef DPT_DUP_WINDOW
+# define DPT_DUP_WINDOW			(500 * TIME_1_MSEC)	// time a request copy is dropped
+#endif
+
+#define DPT_SHAPE_TICK			(10 * TIME_1_MSEC)	// token bucket period unit
+
+#define DPT_CMDE_NB				64		// commands with an entry in the fan-out table
+
+#define DPT_NO_SLOT				0xff	// end of a channel emission queue
+
+#define NB_TRANS				8		// requests waiting for their response
+#define DPT_TRANS_TIME_OUT		(500 * TIME_1_MSEC)	// default response time-out
+#define DPT_NO_CHAN				0xff	// free transaction
+#define DPT_NO_TRANS			0xff	// no transaction recorded
+
+#define FRAME_T_ID_OFFSET		2		// offset of the transaction id in the frame
+
+#define DPT_SUB_MIN				(FRAME_ARGV_OFFSET - FRAME_T_ID_OFFSET)	// sub-frame header size in a burst
+#define DPT_SUB_MAX				(sizeof(frame_t) - FRAME_T_ID_OFFSET)	// full sub-frame size in a burst
+#define DPT_BURST_NB			3		// max number of frames in a burst
+#define DPT_BURST_SIZE			(2 + DPT_BURST_NB * (1 + DPT_SUB_MAX))	// max burst size on the twi bus
+
+#define NB_RETRY_STATS			4		// most retried destinations counted
+
+#if DPT_CHAN_NB > 32
+# error "DPT_CHAN_NB can't exceed 32 channels"
+#endif
+
+// each queued frame holds a slot, so full reception queues
+// shall still leave enough slots for the dispatcher own queues
+#if DPT_SUB_FRAMES < DPT_MOD_FRAMES
+# error "DPT_SUB_FRAMES is lower than the library modules reception queues"
+#endif
+#if NB_POOL_FRAMES < DPT_SUB_FRAMES + NB_IN_FRAMES + NB_OUT_FRAMES + NB_RX_FRAMES - 1
+# error "NB_POOL_FRAMES is lower than the frames the queues can hold"
+#endif
+#if NB_POOL_FRAMES >= DPT_NO_SLOT
+# error "NB_POOL_FRAMES can't exceed 254 frames"
+#endif
+
+
+//----------------------------------------
+// private types
+//
+
+// channels bitfield, the lowest channel having the highest priority
+#if DPT_CHAN_NB > 16
+typedef u32 dpt_chan_mask_t;
+#else
+typedef u16 dpt_chan_mask_t;
+#endif
+
+typedef struct {
+	frame_t fr;		// frame content (first field so a frame reference is a slot reference)
+	u8 ref;			// number of references held on the frame (0 when free)
+	u8 next;		// next slot in the channel emission queue
+	u8 chan;		// source channel giving its priority in the out queue
+} dpt_slot_t;
+
+typedef struct {
+	u32 deadline;	// response time-out time
+	u32 sent;		// request sending time
+	u8 t_id;		// request transaction id
+	u8 cmde;		// request command
+	u8 dest;		// request destination
+	u8 resp_orig;	// expected response origin (DPT_BROADCAST_ADDR for any)
+	u8 channel;		// requesting channel (DPT_NO_CHAN when free)
+	u8 is_call;		// TRUE if the response is kept for DPT_call_done()
+	frame_t* resp;	// response of a call (NULL while awaited)
+} dpt_trans_t;
+
+typedef struct {
+	u16 delivered;	// frames given to the channel
+	u16 dropped;	// frames lost on reception queue full
+	u16 refused;	// frames refused by DPT_tx() or DPT_call()
+	u8 rx_hwm;		// reception queue high-water mark
+	u8 tx_hwm;		// emission queue high-water mark
+} dpt_chan_stats_t;
+
+typedef struct {
+	u32 time;		// reception time
+	u8 orig;		// request origin
+	u8 t_id;		// request transaction id
+	u8 cmde;		// request command
+} dpt_dup_t;
+
+typedef struct {
+	u8 period;		// token period in ticks (0 for no limit)
+	u8 count;		// ticks since the last token
+	u8 tokens;		// available tokens
+	u8 depth;		// bucket depth
+	u16 throttled;	// frames refused by the bandwidth shaping
+} dpt_shape_t;
+
+typedef struct {
+	u16 twi_err;	// twi errors (including time-outs)
+	u16 no_sl;		// no slave responding
+	u16 time_out;	// twi time-outs
+	u16 lost;		// frames lost (malformed, no free frame, fifo full)
+	u16 dup;		// duplicated requests dropped
+	u8 in_hwm;		// in fifo high-water mark
+	u8 out_hwm;		// out queue high-water mark
+	u8 pool_hwm;	// frames pool high-water mark
+} dpt_stats_t;
+
+
+//----------------------------------------
+// private macros
+//
+
+#define DPT_SLOT(fr)	((dpt_slot_t*)(fr))
+
+// bit of the channel in a channels bitfield
+#define DPT_CHAN(i)		((dpt_chan_mask_t)1 << (i))
+
+// bits of the channels of higher or same priority than the given one
+#define DPT_CHAN_UPTO(i)	((DPT_CHAN(i) << 1) - 1)
+
+// highest priority channel of a non-empty channels bitfield
+#if DPT_CHAN_NB > 16
+# define DPT_CHAN_FIRST(chans)	__builtin_ctzl(chans)
+#else
+# define DPT_CHAN_FIRST(chans)	__builtin_ctz(chans)
+#endif
+
+// test if the command is set in the filter (stored in flash)
+#define DPT_MASK_IS_SET(mask, cmde)	(pgm_read_byte(&(mask)[(cmde) >> 3]) & (1 << ((cmde) & 0x07)))
+
+#ifdef DPT_ENABLE_STATS
+// increment a statistic counter without overflow
+# define DPT_COUNT(cnt)	do { if ( (cnt) != 0xffff ) (cnt)++; } while (0)
+
+// update a high-water mark
+# define DPT_HWM(hwm, val)	do { if ( (val) > (hwm) ) (hwm) = (val); } while (0)
+#else
+# define DPT_COUNT(cnt)
+# define DPT_HWM(hwm, val)
+#endif
 
 
 //----------------------------------------
@@ -79,26 +321,70 @@
 
 static struct {
 	dpt_interface_t* channels[DPT_CHAN_NB];	// available channels
-	u64 lock;								// lock bitfield
+#ifdef DPT_ENABLE_FANOUT
+	dpt_chan_mask_t fanout[DPT_CMDE_NB];	// subscribed channels bitfield for each command
+#endif
+	dpt_chan_mask_t high;					// channels subscribed to commands beyond the fan-out table
+
+	dpt_slot_t pool[NB_POOL_FRAMES];		// shared frames
+
+	dpt_trans_t trans[NB_TRANS];			// requests waiting for their response
+	u32 trans_time;							// nearest response deadline
 
 	pt_t appli_pt;							// appli thread
-	fifo_t appli_fifo;
-	frame_t appli_buf[NB_APPLI_FRAMES];
-	frame_t appli;
+	u8 tx_head[DPT_CHAN_NB];				// first slot of each channel emission queue
+	u8 tx_tail[DPT_CHAN_NB];				// last slot of each channel emission queue
+	u8 tx_nb[DPT_CHAN_NB];					// number of frames in each channel emission queue
+	dpt_chan_mask_t tx_pending;				// channels with frames to emit bitfield
+	dpt_chan_mask_t ready;					// channels to run bitfield
+	u32 wake_time[DPT_CHAN_NB];				// channels deadlines
+	frame_t* appli;
 
 	pt_t in_pt;								// in thread
 	fifo_t in_fifo;
-	frame_t in_buf[NB_IN_FRAMES];
-	frame_t in;	
+	frame_t* in_buf[NB_IN_FRAMES];
+	frame_t* in;
+#ifdef DPT_ENABLE_DUP
+	dpt_dup_t dup[NB_DUP];					// last received requests
+	u8 dup_idx;								// next entry to record
+#endif
 
 	pt_t out_pt;							// out thread
-	fifo_t out_fifo;
-	frame_t out_buf[NB_OUT_FRAMES];
-	frame_t out;
-	frame_t hard;
+	frame_t* out[NB_OUT_FRAMES];			// frames to send on the twi bus in arrival order
+	u8 out_age[NB_OUT_FRAMES];				// and the number of times they were passed over
+	u8 nb_out;								// number of frames in the out queue
+	frame_t* hard[DPT_BURST_NB];			// frames of the running twi transfer
+	u8 nb_hard;								// number of frames of the running twi transfer
+	u8 burst[DPT_BURST_SIZE];				// running twi transfer data
+	u8 burst_len;							// running twi transfer size
 	volatile u8 hard_fini;
+	volatile u8 hard_err;					// TRUE if the twi transfer failed
+	volatile u8 hard_no_sl;					// TRUE if no slave responded
+	u8 hard_dest;							// destination of the running twi transfer
+	u8 retry;								// retries of the running twi transfer
+	u32 backoff;							// end of the retry delay
+
+	u8 rx_burst[DPT_BURST_SIZE];			// twi reception buffer
+	frame_t* rx_ring[NB_RX_FRAMES];			// frames from the twi call-back
+	volatile u8 rx_head;					// next ring entry written by the call-back
+	volatile u8 rx_tail;					// next ring entry read by the in thread
+
+#ifdef DPT_ENABLE_SHAPE
+	dpt_shape_t shape[DPT_CHAN_NB];			// channels bandwidth shaping
+	dpt_chan_mask_t throttled;				// channels waiting for a token bitfield
+	u32 shape_time;							// next token bucket tick
+#endif
+
+#ifdef DPT_ENABLE_STATS
+	dpt_chan_mask_t refused;				// channels whose last frame was refused bitfield
+	dpt_chan_stats_t chan_stats[DPT_CHAN_NB];	// channels statistics
+	dpt_stats_t stats;						// dispatcher statistics
+	u8 retry_addr[NB_RETRY_STATS];			// most retried destinations
+	u16 retry_cnt[NB_RETRY_STATS];			// and their retries
+#endif
 
 	u8 sl_addr;								// own I2C slave address
+	u8 groups;								// joined multicast groups bitfield
 	u32 time_out;							// tx time-out time
 	u8 t_id;								// current transaction id value
 } DPT;
@@ -108,73 +394,598 @@ static struct {
 // private functions
 //
 
-// dispatch the frame to each registered listener
-static void DPT_dispatch(frame_t* fr)
+// find a free frame slot and take a reference on it
+// shall be called with interrupts disabled
+static frame_t* DPT_slot(void)
+{
+	frame_t* fr = NULL;
+#ifdef DPT_ENABLE_STATS
+	u8 used = 0;
+#endif
+	u8 i;
+
+	// find the first free slot
+	for ( i = 0; i < NB_POOL_FRAMES; i++ ) {
+		if ( DPT.pool[i].ref == 0 ) {
+			DPT.pool[i].ref = 1;
+			fr = &DPT.pool[i].fr;
+			break;
+		}
+	}
+
+#ifdef DPT_ENABLE_STATS
+	// count the used ones
+	for ( i = 0; i < NB_POOL_FRAMES; i++ ) {
+		if ( DPT.pool[i].ref != 0 ) {
+			used++;
+		}
+	}
+	DPT_HWM(DPT.stats.pool_hwm, used);
+#endif
+
+	return fr;
+}
+
+
+// find a free frame slot from the threads context
+static frame_t* DPT_alloc(void)
+{
+	frame_t* fr;
+
+	// the twi call-back can also take slots
+	cli();
+	fr = DPT_slot();
+	sei();
+
+	return fr;
+}
+
+
+// enqueue a frame reference in the twi reception ring
+// shall only be called from the twi call-back or with the interrupts disabled
+static void DPT_rx_put(frame_t* fr)
+{
+	u8 head = (DPT.rx_head + 1) % NB_RX_FRAMES;
+
+	// if the ring is full
+	if ( head == DPT.rx_tail ) {
+		// the frame is lost
+		DPT_COUNT(DPT.stats.lost);
+		DPT_free(fr);
+		return;
+	}
+
+	DPT.rx_ring[DPT.rx_head] = fr;
+	DPT.rx_head = head;
+}
+
+
+// dequeue a frame reference from the twi reception ring
+// shall only be called from the in thread
+static u8 DPT_rx_get(frame_t** fr)
+{
+	// if the ring is empty
+	if ( DPT.rx_tail == DPT.rx_head ) {
+		return KO;
+	}
+
+	*fr = DPT.rx_ring[DPT.rx_tail];
+	DPT.rx_tail = (DPT.rx_tail + 1) % NB_RX_FRAMES;
+
+	return OK;
+}
+
+
+// take one more reference on the frame
+static void DPT_hold(frame_t* fr)
+{
+	DPT_SLOT(fr)->ref++;
+}
+
+
+// check if the local node shall receive the frames sent to the address
+// by the other nodes (broadcast or joined multicast group)
+static u8 DPT_is_member(u8 addr)
+{
+	if ( addr == DPT_BROADCAST_ADDR ) {
+		return TRUE;
+	}
+
+	return DPT_IS_GROUP(addr) && (DPT.groups & (1 << (addr - DPT_GROUP_FIRST_ADDR)));
+}
+
+
+// enqueue a frame reference in the in fifo
+// if it fails, the reference is released
+static void DPT_put(frame_t* fr)
+{
+	if ( KO == FIFO_put(&DPT.in_fifo, &fr) ) {
+		DPT_COUNT(DPT.stats.lost);
+		DPT_free(fr);
+		return;
+	}
+
+	// update the fifo high-water mark
+	DPT_HWM(DPT.stats.in_hwm, FIFO_full(&DPT.in_fifo));
+}
+
+
+// append a frame reference to the out queue
+// if it fails, the reference is released
+static void DPT_out_put(frame_t* fr)
+{
+	if ( DPT.nb_out == NB_OUT_FRAMES ) {
+		DPT_COUNT(DPT.stats.lost);
+		DPT_free(fr);
+		return;
+	}
+
+	DPT.out[DPT.nb_out] = fr;
+	DPT.out_age[DPT.nb_out] = 0;
+	DPT.nb_out++;
+
+	// update the queue high-water mark
+	DPT_HWM(DPT.stats.out_hwm, DPT.nb_out);
+}
+
+
+// remove the given entry from the out queue keeping the arrival order
+static frame_t* DPT_out_del(u8 idx)
+{
+	frame_t* fr = DPT.out[idx];
+
+	DPT.nb_out--;
+	for ( ; idx < DPT.nb_out; idx++ ) {
+		DPT.out[idx] = DPT.out[idx + 1];
+		DPT.out_age[idx] = DPT.out_age[idx + 1];
+	}
+
+	return fr;
+}
+
+
+// take the frame of highest priority from the out queue
+// the priority of a frame is its source channel lowered by its age
+// and the oldest one wins on equal priorities
+static u8 DPT_out_get(frame_t** fr)
+{
+	s16 prio;
+	s16 best_prio = 0;
+	u8 best = 0;
+	u8 i;
+
+	// if the queue is empty
+	if ( DPT.nb_out == 0 ) {
+		return KO;
+	}
+
+	// find the frame of highest priority
+	for ( i = 0; i < DPT.nb_out; i++ ) {
+		prio = (s16)DPT_SLOT(DPT.out[i])->chan - DPT.out_age[i];
+		if ( (i == 0) || (prio < best_prio) ) {
+			best_prio = prio;
+			best = i;
+		}
+	}
+
+	*fr = DPT_out_del(best);
+
+	// the frames left behind get older
+	for ( i = 0; i < DPT.nb_out; i++ ) {
+		if ( DPT.out_age[i] != DPT_AGE_MAX ) {
+			DPT.out_age[i]++;
+		}
+	}
+
+	return OK;
+}
+
+
+// append the frame to the emission queue of the channel
+static void DPT_tx_put(u8 channel, frame_t* fr)
+{
+	u8 idx = DPT_SLOT(fr) - DPT.pool;
+
+	DPT.pool[idx].next = DPT_NO_SLOT;
+	DPT.pool[idx].chan = channel;
+
+	// link it after the last queued frame if any
+	if ( DPT.tx_nb[channel] ) {
+		DPT.pool[DPT.tx_tail[channel]].next = idx;
+	}
+	else {
+		DPT.tx_head[channel] = idx;
+	}
+	DPT.tx_tail[channel] = idx;
+	DPT.tx_nb[channel]++;
+	DPT_HWM(DPT.chan_stats[channel].tx_hwm, DPT.tx_nb[channel]);
+
+	DPT.tx_pending |= DPT_CHAN(channel);
+}
+
+
+// take the oldest frame of the highest priority channel
+// at least one channel shall be pending
+static frame_t* DPT_tx_get(void)
+{
+	dpt_slot_t* slot;
+	u8 channel;
+
+	// the lowest pending channel has the highest priority
+	channel = DPT_CHAN_FIRST(DPT.tx_pending);
+
+	// unlink its first frame
+	slot = &DPT.pool[DPT.tx_head[channel]];
+	DPT.tx_head[channel] = slot->next;
+	DPT.tx_nb[channel]--;
+
+	// if the queue was full, the channel can send again
+	if ( DPT.tx_nb[channel] == NB_TX_FRAMES - 1 ) {
+		DPT.ready |= DPT_CHAN(channel);
+	}
+
+	// if its queue is now empty
+	if ( DPT.tx_nb[channel] == 0 ) {
+		DPT.tx_pending &= ~DPT_CHAN(channel);
+	}
+
+	return &slot->fr;
+}
+
+
+// update the fan-out table with the command filter of the given channel
+static void DPT_fanout_update(u8 channel, const u8* cmde_mask)
+{
+	u8 octet;
+	u8 i;
+
+	// remove the channel from every subscription
+#ifdef DPT_ENABLE_FANOUT
+	for ( i = 0; i < DPT_CMDE_NB; i++ ) {
+		DPT.fanout[i] &= ~DPT_CHAN(channel);
+	}
+#endif
+	DPT.high &= ~DPT_CHAN(channel);
+
+	// a channel without filter or without queue can't receive any frame
+	if ( (cmde_mask == NULL) || (DPT.channels[channel]->queue == NULL) ) {
+		return;
+	}
+
+#ifdef DPT_ENABLE_FANOUT
+	// for each command of the fan-out table
+	for ( i = 0; i < DPT_CMDE_NB; i++ ) {
+		if ( DPT_MASK_IS_SET(cmde_mask, i) ) {
+			DPT.fanout[i] |= DPT_CHAN(channel);
+		}
+	}
+
+	// for the other commands, only note the channel subscribes to some
+	i = DPT_CMDE_NB / 8;
+#else
+	// only note the channel subscribes to some commands
+	i = 0;
+#endif
+	for ( ; i < FR_MASK_SIZE; i++ ) {
+		octet = pgm_read_byte(&cmde_mask[i]);
+		if ( octet ) {
+			DPT.high |= DPT_CHAN(channel);
+			break;
+		}
+	}
+}
+
+
+// give a reference on the frame to the channel
+static void DPT_deliver(u8 channel, frame_t* fr)
+{
+	// enqueue a reference on the frame
+	DPT_hold(fr);
+	if ( OK == FIFO_put(DPT.channels[channel]->queue, &fr) ) {
+		// if a success, wake its application up
+		DPT.ready |= DPT_CHAN(channel);
+
+		DPT_COUNT(DPT.chan_stats[channel].delivered);
+		DPT_HWM(DPT.chan_stats[channel].rx_hwm, FIFO_full(DPT.channels[channel]->queue));
+	}
+	else {
+		// else give the reference back
+		DPT_free(fr);
+
+		DPT_COUNT(DPT.chan_stats[channel].dropped);
+	}
+}
+
+
+// record a request sent by the channel
+// return the transaction index or DPT_NO_TRANS
+static u8 DPT_trans_add(u8 channel, frame_t* fr, u32 time_out, u8 is_call)
+{
+	u8 i;
+
+	// broadcast and multicast requests get several responses
+	// and a channel without queue can't receive its response
+	// (a call keeps its first response whatever)
+	if ( !is_call && ( (fr->dest == DPT_BROADCAST_ADDR) || DPT_IS_GROUP(fr->dest) || (DPT.channels[channel]->queue == NULL) ) ) {
+		return DPT_NO_TRANS;
+	}
+
+	// find a free transaction
+	for ( i = 0; i < NB_TRANS; i++ ) {
+		if ( DPT.trans[i].channel == DPT_NO_CHAN ) {
+			DPT.trans[i].channel = channel;
+			DPT.trans[i].t_id = fr->t_id;
+			DPT.trans[i].cmde = fr->cmde;
+			DPT.trans[i].dest = fr->dest;
+			DPT.trans[i].resp_orig = fr->dest;
+			DPT.trans[i].sent = TIME_get();
+			DPT.trans[i].deadline = DPT.trans[i].sent + time_out;
+			DPT.trans[i].is_call = is_call;
+			DPT.trans[i].resp = NULL;
+
+			// update the nearest deadline
+			if ( DPT.trans[i].deadline < DPT.trans_time ) {
+				DPT.trans_time = DPT.trans[i].deadline;
+			}
+
+			return i;
+		}
+	}
+
+	// if the table is full, the response will be
+	// given to every subscriber as if not requested
+	return DPT_NO_TRANS;
+}
+
+
+// set the node expected to respond to a recorded request once it is routed
+static void DPT_trans_route(frame_t* fr, u8 nb_routes, u8 route)
+{
+	dpt_trans_t* tr;
+	u8 i;
+
+	for ( i = 0; i < NB_TRANS; i++ ) {
+		tr = &DPT.trans[i];
+
+		if ( (tr->channel == DPT_SLOT(fr)->chan) && (tr->resp == NULL) && (tr->t_id == fr->t_id) && (tr->cmde == fr->cmde) ) {
+			// several nodes can respond to a request
+			// routed to several ones or sent to a broadcast or multicast address
+			if ( (nb_routes != 1) || (route == DPT_BROADCAST_ADDR) || DPT_IS_GROUP(route) ) {
+				tr->resp_orig = DPT_BROADCAST_ADDR;
+			}
+			else {
+				tr->resp_orig = route;
+			}
+
+			return;
+		}
+	}
+}
+
+
+// give the response of a recorded request to its channel
+// return OK if the request is found
+static u8 DPT_trans_resp(frame_t* fr)
+{
+	dpt_trans_t* tr;
+	u8 i;
+
+	for ( i = 0; i < NB_TRANS; i++ ) {
+		tr = &DPT.trans[i];
+
+		if ( (tr->channel != DPT_NO_CHAN) && (tr->resp == NULL) && (tr->t_id == fr->t_id) && (tr->cmde == fr->cmde)
+				&& ( (tr->resp_orig == DPT_BROADCAST_ADDR) || (tr->resp_orig == fr->orig) ) ) {
+			// the routing tables learn how fast the node responds
+			if ( !fr->error && !fr->time_out ) {
+				ROUT_latency(fr->orig, TIME_get() - tr->sent);
+			}
+
+			// a call keeps its response until it is taken
+			if ( tr->is_call ) {
+				DPT_hold(fr);
+				tr->resp = fr;
+				DPT.ready |= DPT_CHAN(tr->channel);
+			}
+			// else the response is queued and the request released
+			else {
+				DPT_deliver(tr->channel, fr);
+				tr->channel = DPT_NO_CHAN;
+			}
+
+			return OK;
+		}
+	}
+
+	return KO;
+}
+
+
+// give a time-out response for each request with an elapsed deadline
+static void DPT_trans_expire(void)
 {
+	dpt_trans_t* tr;
+	frame_t* fr;
+	u32 time;
 	u8 i;
-	fr_cmdes_t cmde = fr->cmde;
 
-	// for each registered commands ranges
-	for (i = 0; i < DPT_CHAN_NB; i++) {
-		// if channel is not registered
-		if ( DPT.channels[i] == NULL )
-			// skip to following
+	time = TIME_get();
+
+	// the nearest deadline is computed again
+	DPT.trans_time = TIME_MAX;
+
+	for ( i = 0; i < NB_TRANS; i++ ) {
+		tr = &DPT.trans[i];
+
+		// free or already answered
+		if ( (tr->channel == DPT_NO_CHAN) || (tr->resp != NULL) ) {
 			continue;
+		}
+
+		// if the deadline is elapsed
+		if ( time > tr->deadline ) {
+			// a request not sent as a call is forgotten
+			if ( !tr->is_call ) {
+				tr->channel = DPT_NO_CHAN;
+				continue;
+			}
 
-		// if command is in a range
-		if ( DPT.channels[i]->cmde_mask & _CM(cmde) ) {
-			// enqueue it if a queue is available
-			if ( DPT.channels[i]->queue && (OK == FIFO_put(DPT.channels[i]->queue, fr)) ) {
-				// if a success, lock the channel
-				DPT.lock |= 1 << i;
+			// a call gets a time-out response if a frame is available
+			if ( NULL != (fr = DPT_alloc()) ) {
+				memset(fr, 0, sizeof(frame_t));
+				fr->dest = DPT.sl_addr;
+				fr->orig = tr->dest;
+				fr->t_id = tr->t_id;
+				fr->cmde = tr->cmde;
+				fr->resp = 1;
+				fr->time_out = 1;
+
+				// and keeps it until it is taken
+				tr->resp = fr;
+				DPT.ready |= DPT_CHAN(tr->channel);
+				continue;
 			}
 		}
+
+		// update the nearest deadline
+		if ( tr->deadline < DPT.trans_time ) {
+			DPT.trans_time = tr->deadline;
+		}
+	}
+}
+
+
+// find the channels whose filter accepts the command
+// only the channels subscribed to commands beyond the fan-out table are checked
+static dpt_chan_mask_t DPT_subscribers(u8 cmde)
+{
+	dpt_chan_mask_t chans = 0;
+	u8 i;
+
+	for ( i = 0; i < DPT_CHAN_NB; i++ ) {
+		if ( (DPT.high & DPT_CHAN(i)) && DPT_MASK_IS_SET(DPT.channels[i]->cmde_mask, cmde) ) {
+			chans |= DPT_CHAN(i);
+		}
+	}
+
+	return chans;
+}
+
+
+// dispatch the frame to each registered listener
+static void DPT_dispatch(frame_t* fr)
+{
+	dpt_chan_mask_t chans;
+	u8 i;
+
+	// if the frame is the response of a recorded request
+	if ( fr->resp && DPT_trans_resp(fr) ) {
+		// only the requester gets it
+		return;
+	}
+
+#ifdef DPT_ENABLE_FANOUT
+	// if the command has its subscribed channels in the fan-out table
+	if ( fr->cmde < DPT_CMDE_NB ) {
+		// retrieve them
+		chans = DPT.fanout[fr->cmde];
+	}
+	else {
+		// else check the filter of each channel subscribed to such commands
+		chans = DPT_subscribers(fr->cmde);
+	}
+#else
+	// check the filter of each subscribed channel
+	chans = DPT_subscribers(fr->cmde);
+#endif
+
+	// for each subscribed channel
+	while ( chans ) {
+		// extract the highest priority one
+		i = DPT_CHAN_FIRST(chans);
+		chans &= chans - 1;
+
+		// give it a reference on the frame
+		DPT_deliver(i, fr);
 	}
 }
 
 
 static PT_THREAD( DPT_appli(pt_t* pt) )
 {
-	frame_t fr;
+	frame_t* fr;
 	u8 routes[MAX_ROUTES];
 	u8 nb_routes;
 	u8 i;
 
 	PT_BEGIN(pt);
 
-	// if any awaiting incoming frames
-	PT_WAIT_UNTIL(pt, FIFO_get(&DPT.appli_fifo, &fr));
+	// wait until any channel has a frame to emit
+	PT_WAIT_UNTIL(pt, DPT.tx_pending);
+
+	// and take the one of highest priority
+	DPT.appli = DPT_tx_get();
 
 	// route the frame
-	ROUT_route(fr.dest, routes, &nb_routes);
+	nb_routes = MAX_ROUTES;
+	ROUT_route(DPT.appli->dest, routes, &nb_routes);
 
 	// no route
 	if ( nb_routes == 0 ) {
 		// so we will send it unmodify
 		// but tweecking the resulting route
 		nb_routes = 1;
-		routes[0] = fr.dest;
+		routes[0] = DPT.appli->dest;
+	}
+
+	// the response of a request is expected from the routed node
+	if ( !DPT.appli->resp ) {
+		DPT_trans_route(DPT.appli, nb_routes, routes[0]);
 	}
 
 	for ( i = 0; i < nb_routes; i++ ) {
-		fr.dest = routes[i];
+		// the last route takes the frame itself
+		if ( i == nb_routes - 1 ) {
+			fr = DPT.appli;
+			DPT.appli = NULL;
+		}
+		// the others need their own copy as the destination differs
+		else {
+			fr = DPT_alloc();
+			if ( fr == NULL ) {
+				// the pool is exhausted, this route is lost
+				DPT_COUNT(DPT.stats.lost);
+				continue;
+			}
+			*fr = *DPT.appli;
+			DPT_SLOT(fr)->chan = DPT_SLOT(DPT.appli)->chan;
+		}
+
+		fr->dest = routes[i];
 		// if the frame destination is only local
-		if ( (fr.dest == DPT_SELF_ADDR) || (fr.dest == DPT.sl_addr) ) {
-			FIFO_put(&DPT.in_fifo, &fr);
+		if ( (fr->dest == DPT_SELF_ADDR) || (fr->dest == DPT.sl_addr) ) {
+			DPT_put(fr);
 
 			// short cut the handling to speed up
 			break;
 		}
 
-		// if broadcasting
-		if (fr.dest == DPT_BROADCAST_ADDR) {
+		// and finally goes to distant node
+		fr->orig = DPT.sl_addr;
+
+		// if broadcasting or multicasting to a joined group
+		if ( DPT_is_member(fr->dest) ) {
 			// also goes to local node
-			FIFO_put(&DPT.in_fifo, &fr);
+			DPT_hold(fr);
+			DPT_put(fr);
 		}
 
-		// and finally goes to distant node
-		fr.orig = DPT.sl_addr;
-		FIFO_put(&DPT.out_fifo, &fr);
+		DPT_out_put(fr);
+	}
+
+	// if a local route short cut the others
+	if ( DPT.appli != NULL ) {
+		// the frame itself is no more used
+		DPT_free(DPT.appli);
 	}
 
 	// so loop back for the next frame
@@ -184,17 +995,58 @@ static PT_THREAD( DPT_appli(pt_t* pt) )
 }
 
 
-static PT_THREAD( DPT_in(pt_t* pt) )
+#ifdef DPT_ENABLE_DUP
+// check if the request was already received a short time ago
+// else record it
+static u8 DPT_dup(frame_t* fr)
 {
-	frame_t fr;
+	dpt_dup_t* d;
+	u32 time = TIME_get();
+	u8 i;
 
+	for ( i = 0; i < NB_DUP; i++ ) {
+		d = &DPT.dup[i];
+		if ( (d->orig == fr->orig) && (d->t_id == fr->t_id) && (d->cmde == fr->cmde)
+				&& (time - d->time < DPT_DUP_WINDOW) ) {
+			return TRUE;
+		}
+	}
+
+	// the oldest entry is replaced
+	d = &DPT.dup[DPT.dup_idx];
+	d->time = time;
+	d->orig = fr->orig;
+	d->t_id = fr->t_id;
+	d->cmde = fr->cmde;
+	DPT.dup_idx = (DPT.dup_idx + 1) % NB_DUP;
+
+	return FALSE;
+}
+#endif
+
+
+static PT_THREAD( DPT_in(pt_t* pt) )
+{
 	PT_BEGIN(pt);
 
 	// if any awaiting incoming frames
-	PT_WAIT_UNTIL(pt, FIFO_get(&DPT.in_fifo, &fr));
+	// the remote ones first
+	PT_WAIT_UNTIL(pt, DPT_rx_get(&DPT.in) || FIFO_get(&DPT.in_fifo, &DPT.in));
+
+#ifdef DPT_ENABLE_DUP
+	// dispatch the frame unless it is a copy of a request
+	if ( !DPT.in->resp && DPT_dup(DPT.in) ) {
+		DPT_COUNT(DPT.stats.dup);
+	}
+	else {
+		DPT_dispatch(DPT.in);
+	}
+#else
+	DPT_dispatch(DPT.in);
+#endif
 
-	// dispatch the frame
-	DPT_dispatch(&fr);
+	// the receivers hold their own references
+	DPT_free(DPT.in);
 
 	// the frame has been sent to its destination
 	// so loop back for the next frame
@@ -204,58 +1056,336 @@ static PT_THREAD( DPT_in(pt_t* pt) )
 }
 
 
-static PT_THREAD( DPT_out(pt_t* pt) )
+// compute the number of arguments of the frame to send on the twi bus
+// the arguments after the last non null one are not sent
+static u8 DPT_nb_args(frame_t* fr)
 {
-	u8 twi_res;
+	u8 nb_args;
 
-	PT_BEGIN(pt);
+	for ( nb_args = FRAME_NB_ARGS; nb_args > 0; nb_args-- ) {
+		if ( fr->argv[nb_args - 1] ) {
+			break;
+		}
+	}
 
-	// if no twi transfer running
-	if ( DPT.hard_fini == OK ) {
-		// read any available frame
-		PT_WAIT_UNTIL(pt, FIFO_get(&DPT.out_fifo, &DPT.hard));
+	return nb_args;
+}
 
-		// compute and save time-out limit
-		// byte transmission is typically 100 us
-		DPT.time_out = TIME_get() + TIME_1_MSEC * sizeof(frame_t);
 
-		// now a twi transfer shall begin
-		DPT.hard_fini = KO;
+// append the frame to the burst to send on the twi bus
+static void DPT_burst_add(frame_t* fr)
+{
+	u8 len;
+
+	// sub-frame size then the frame from the transaction id
+	len = DPT_SUB_MIN + DPT_nb_args(fr);
+	DPT.burst[DPT.burst_len] = len;
+	memcpy(&DPT.burst[DPT.burst_len + 1], (u8*)fr + FRAME_T_ID_OFFSET, len);
+	DPT.burst_len += 1 + len;
+
+	DPT.hard[DPT.nb_hard] = fr;
+	DPT.nb_hard++;
+}
+
+
+// gather the queued frames for the same destination with the first one
+static void DPT_burst_build(void)
+{
+	frame_t* fr;
+	u8 i;
+
+	// the general call bursts begin with their destination
+	DPT.burst_len = 0;
+	if ( (DPT.hard[0]->dest == DPT_BROADCAST_ADDR) || DPT_IS_GROUP(DPT.hard[0]->dest) ) {
+		DPT.burst[DPT.burst_len++] = DPT.hard[0]->dest;
 	}
 
+	// then the common origin
+	DPT.burst[DPT.burst_len++] = DPT.hard[0]->orig;
+	DPT.nb_hard = 0;
+	DPT_burst_add(DPT.hard[0]);
+
+	// the frames are taken in arrival order
+	// to keep the order of the frames of each channel
+	i = 0;
+	while ( (DPT.nb_hard < DPT_BURST_NB) && (i < DPT.nb_out) ) {
+		fr = DPT.out[i];
+
+		// raw I2C frames and frames for other nodes can't join the burst
+		if ( (fr->dest != DPT.hard[0]->dest) || (fr->orig != DPT.hard[0]->orig)
+				|| (fr->cmde == FR_I2C_READ) || (fr->cmde == FR_I2C_WRITE) ) {
+			i++;
+			continue;
+		}
+
+		DPT_burst_add(DPT_out_del(i));
+	}
+}
+
+
+// start the twi transfer of the DPT.hard frames
+static u8 DPT_hard_tx(void)
+{
+	u8 twi_res;
+
+	// compute and save time-out limit
+	// byte transmission is typically 100 us
+	DPT.time_out = TIME_get() + TIME_1_MSEC * DPT.burst_len;
+
 	// read from and write to an I2C component are handled specificly
 	// the frame characteristics to correctly complete the fields of the response
 	// in case of I2C read or write are taken from the DPT.hard frame
-	switch ( DPT.hard.cmde ) {
+	switch ( DPT.hard[0]->cmde ) {
 		case FR_I2C_READ:
-			twi_res = TWI_ms_rx(DPT.hard.dest, DPT.hard.len, (u8*)&DPT.hard + FRAME_ARGV_OFFSET);
+			twi_res = TWI_ms_rx(DPT.hard[0]->dest, DPT.hard[0]->len, (u8*)DPT.hard[0] + FRAME_ARGV_OFFSET);
 			break;
 
 		case FR_I2C_WRITE:
-			twi_res = TWI_ms_tx(DPT.hard.dest, DPT.hard.len, (u8*)&DPT.hard + FRAME_ARGV_OFFSET);
+			twi_res = TWI_ms_tx(DPT.hard[0]->dest, DPT.hard[0]->len, (u8*)DPT.hard[0] + FRAME_ARGV_OFFSET);
+			break;
+
+		default:
+			// the multicast frames are sent with a general call
+			if ( DPT_IS_GROUP(DPT.hard[0]->dest) ) {
+				twi_res = TWI_ms_tx(DPT_BROADCAST_ADDR, DPT.burst_len, DPT.burst);
+			}
+			else {
+				twi_res = TWI_ms_tx(DPT.hard[0]->dest, DPT.burst_len, DPT.burst);
+			}
+			break;
+	}
+
+	// if the TWI is not able to sent the frame
+	if ( twi_res == KO ) {
+		// prevent time-out signalling
+		DPT.time_out = TIME_MAX;
+	}
+
+	return twi_res;
+}
+
+
+// enqueue the frame of the running twi transfer as a response
+// the header shall already be updated
+static void DPT_hard_resp(frame_t* fr)
+{
+	// the frame is modified in place
+	// so it must not be shared (broadcast frame also given to the local node)
+	if ( DPT_SLOT(fr)->ref != 1 ) {
+		// then the response is lost
+		return;
+	}
+
+	// the out thread keeps its reference until the transfer end
+	DPT_hold(fr);
+	DPT_rx_put(fr);
+}
+
+
+// turn every frame of the running twi transfer into a failed response
+static void DPT_hard_fail(u8 time_out)
+{
+	frame_t* fr;
+	u8 i;
+
+	for ( i = 0; i < DPT.nb_hard; i++ ) {
+		fr = DPT.hard[i];
+
+		// if the slave doesn't respond
+		// whether the I2C address is free, so take it
+		// or the slave has crached
+		// whatever the problem, put a failed resp in rx frame
+		// as the comm was locally initiated
+		// all the fields are those of DPT.hard frame
+		// if the transfer can't be done, it is also in error
+		// the response comes from the destination
+		// to be matched with its request
+		if ( time_out ) {
+			fr->time_out = 1;
+		}
+		fr->orig = fr->dest;
+		fr->error = 1;
+		fr->dest = DPT.sl_addr;
+		fr->resp = 1;
+
+		// enqueue the response
+		DPT_hard_resp(fr);
+	}
+}
+
+
+#ifdef DPT_ENABLE_STATS
+// count one more retry for the destination
+static void DPT_retry_count(u8 addr)
+{
+	u8 min = 0;
+	u8 i;
+
+	for ( i = 0; i < NB_RETRY_STATS; i++ ) {
+		// if the destination is already counted
+		if ( DPT.retry_addr[i] == addr ) {
+			// prevent overflow
+			if ( DPT.retry_cnt[i] != 0xffff ) {
+				DPT.retry_cnt[i]++;
+			}
+			return;
+		}
+
+		// remind the least retried destination
+		if ( DPT.retry_cnt[i] < DPT.retry_cnt[min] ) {
+			min = i;
+		}
+	}
+
+	// the least retried destination is replaced
+	DPT.retry_addr[min] = addr;
+	DPT.retry_cnt[min] = 1;
+}
+#endif
+
+
+static PT_THREAD( DPT_out(pt_t* pt) )
+{
+	u8 i;
+
+	PT_BEGIN(pt);
+
+	// read any available frame
+	PT_WAIT_UNTIL(pt, DPT_out_get(&DPT.hard[0]));
+	DPT.hard_dest = DPT.hard[0]->dest;
+
+	// raw I2C frames are sent alone
+	if ( (DPT.hard[0]->cmde == FR_I2C_READ) || (DPT.hard[0]->cmde == FR_I2C_WRITE) ) {
+		DPT.nb_hard = 1;
+		DPT.burst_len = sizeof(frame_t);	// only used for the time-out
+	}
+	// the others take the following frames for the same node with them
+	else {
+		DPT_burst_build();
+	}
+
+	DPT.retry = 0;
+	while (1) {
+		// now a twi transfer shall begin
+		DPT.hard_fini = KO;
+		DPT.hard_err = FALSE;
+		DPT.hard_no_sl = FALSE;
+
+		// if the twi accepts the frames
+		if ( DPT_hard_tx() ) {
+			// wait until the twi transfer is done
+			PT_WAIT_UNTIL(pt, DPT.hard_fini == OK);
+		}
+		else {
+			// the bus is busy
+			DPT.hard_fini = OK;
+			DPT.hard_err = TRUE;
+		}
+
+		// if the transfer is done
+		if ( !DPT.hard_err ) {
 			break;
+		}
+
+		// the transfer failed (busy bus, arbitration lost, time-out)
+#ifdef DPT_ENABLE_STATS
+		DPT_retry_count(DPT.hard[0]->dest);
+#endif
+		DPT.retry++;
+
+		// if the retry budget is exhausted
+		if ( DPT.retry > DPT_RETRY_MAX ) {
+			// the senders get a failed response
+			// the reception ring is shared with the twi call-back
+			cli();
+			DPT_hard_fail(TRUE);
+			sei();
+			break;
+		}
+
+		// wait a random time in a window doubling at each retry
+		// to let the other masters go
+		i = (DPT.retry < DPT_BACKOFF_SHIFT_MAX) ? DPT.retry : DPT_BACKOFF_SHIFT_MAX;
+		DPT.backoff = TIME_get() + (1 + (rand() & ((1 << i) - 1))) * TIME_1_MSEC;
+		PT_WAIT_UNTIL(pt, TIME_get() > DPT.backoff);
+	}
+
+	// tell the routing tables if the destination responds
+	if ( DPT.hard_err || DPT.hard_no_sl ) {
+		ROUT_dead(DPT.hard_dest);
+	}
+	else {
+		ROUT_alive(DPT.hard_dest);
+	}
+
+	// the frames are no more used by the out thread
+	for ( i = 0; i < DPT.nb_hard; i++ ) {
+		DPT_free(DPT.hard[i]);
+	}
+	DPT.nb_hard = 0;
+
+	// and loop back for another transfer
+	PT_RESTART(pt);
+
+	PT_END(pt);
+}
+
+
+// split an incoming burst into frames
+static void DPT_rx_end(u8 nb_data, u8 gencall)
+{
+	frame_t* fr;
+	u8 dest = DPT.sl_addr;
+	u8 hdr = 0;
+	u8 len;
+	u8 i;
+
+	// a general call burst begins with its destination
+	if ( gencall ) {
+		if ( nb_data == 0 ) {
+			return;
+		}
 
-		default:
-			twi_res = TWI_ms_tx(DPT.hard.dest, sizeof(frame_t) - FRAME_ORIG_OFFSET, (u8*)&DPT.hard + FRAME_ORIG_OFFSET);
-			break;
+		// the frames for a group not joined are dropped
+		if ( !DPT_is_member(DPT.rx_burst[hdr]) ) {
+			return;
+		}
+
+		// the multicast frames keep their group address
+		if ( DPT_IS_GROUP(DPT.rx_burst[hdr]) ) {
+			dest = DPT.rx_burst[hdr];
+		}
+		hdr++;
 	}
 
-	// if the TWI is not able to sent the frame
-	if ( twi_res == KO ) {
-		// prevent time-out signalling
-		DPT.time_out = TIME_MAX;
+	// skip the common origin
+	for ( i = hdr + 1; i < nb_data; i += 1 + len ) {
+		len = DPT.rx_burst[i];
 
-		// retry sending the frame
-		PT_RESTART(pt);
-	}
+		// if the sub-frame size is not correct
+		if ( (len < DPT_SUB_MIN) || (len > DPT_SUB_MAX) || (i + 1 + len > nb_data) ) {
+			// the rest of the burst is ignored
+			DPT_COUNT(DPT.stats.lost);
+			return;
+		}
 
-	// wait until the twi transfer is done
-	PT_WAIT_UNTIL(pt, DPT.hard_fini != OK);
+		// store the frame in a free slot
+		fr = DPT_slot();
+		if ( fr == NULL ) {
+			// no slot left, the rest of the burst is lost
+			DPT_COUNT(DPT.stats.lost);
+			return;
+		}
+		fr->dest = dest;
+		fr->orig = DPT.rx_burst[hdr];
+		memcpy((u8*)fr + FRAME_T_ID_OFFSET, &DPT.rx_burst[i + 1], len);
 
-	// and loop back for another transfer
-	PT_RESTART(pt);
+		// the arguments not sent are null
+		memset((u8*)fr + FRAME_T_ID_OFFSET + len, 0, DPT_SUB_MAX - len);
 
-	PT_END(pt);
+		// enqueue the incoming frame
+		DPT_rx_put(fr);
+	}
 }
 
 
@@ -270,19 +1400,11 @@ static void DPT_I2C_call_back(twi_state_t state, u8 nb_data, void* misc)
 	// upon the state
 	switch ( state ) {
 		case TWI_NO_SL:
-			// if the slave doesn't respond
-			// whether the I2C address is free, so take it
-			// or the slave has crached
-			// whatever the problem, put a failed resp in rx frame
-			// as the comm was locally initiated
-			// all the fields are those of DPT.hard frame
-			DPT.hard.orig = DPT.hard.dest;
-			DPT.hard.dest = DPT.sl_addr;
-			DPT.hard.resp = 1;
-			DPT.hard.error = 1;
-
-			// enqueue the response
-			FIFO_put(&DPT.in_fifo, &DPT.hard);
+			DPT_COUNT(DPT.stats.no_sl);
+			DPT.hard_no_sl = TRUE;
+
+			// put a failed resp for each frame
+			DPT_hard_fail(FALSE);
 
 			// and stop the com
 			TWI_stop();
@@ -297,15 +1419,15 @@ static void DPT_I2C_call_back(twi_state_t state, u8 nb_data, void* misc)
 
 			// simple I2C actions are directly handled
 			// communications with other nodes will received a response later
-			if ( (DPT.hard.cmde == FR_I2C_READ) || (DPT.hard.cmde == FR_I2C_WRITE) ) {
+			if ( (DPT.hard[0]->cmde == FR_I2C_READ) || (DPT.hard[0]->cmde == FR_I2C_WRITE) ) {
 				// update header
-				DPT.hard.orig = DPT.hard.dest;
-				DPT.hard.dest = DPT_SELF_ADDR;
-				DPT.hard.resp = 1;
-				DPT.hard.error = 0;
+				DPT.hard[0]->orig = DPT.hard[0]->dest;
+				DPT.hard[0]->dest = DPT_SELF_ADDR;
+				DPT.hard[0]->resp = 1;
+				DPT.hard[0]->error = 0;
 
 				// enqueue the response
-				FIFO_put(&DPT.in_fifo, &DPT.hard);
+				DPT_hard_resp(DPT.hard[0]);
 			}
 
 			// and stop the com
@@ -315,25 +1437,17 @@ static void DPT_I2C_call_back(twi_state_t state, u8 nb_data, void* misc)
 			break;
 
 		case TWI_SL_RX_BEGIN:
-			// just provide a buffer to store the incoming frame
-			// only the origin, the cmde/resp and the arguments are received
-			DPT.hard_fini = KO;
-			DPT.hard.dest = DPT.sl_addr;
-			TWI_sl_rx(sizeof(frame_t) - FRAME_ORIG_OFFSET, (u8*)&DPT.hard + FRAME_ORIG_OFFSET);
+			// just provide a buffer to store the incoming burst
+			TWI_sl_rx(sizeof(DPT.rx_burst), DPT.rx_burst);
 
 			break;
 
 		case TWI_SL_RX_END:
-			// if the msg len is correct
-			if ( nb_data == (sizeof(frame_t) - FRAME_ORIG_OFFSET)) {
-				// enqueue the response
-				FIFO_put(&DPT.in_fifo, &DPT.hard);
-			}
-			// else it is ignored
+			// enqueue the frames if correct
+			DPT_rx_end(nb_data, FALSE);
 
 			// release the bus
 			TWI_stop();
-			DPT.hard_fini = OK;
 
 			break;
 
@@ -348,36 +1462,28 @@ static void DPT_I2C_call_back(twi_state_t state, u8 nb_data, void* misc)
 			break;
 
 		case TWI_GENCALL_BEGIN:
-			// just provide a buffer to store the incoming frame
-			// only the origin, the cmde/resp and the arguments are received
-			DPT.hard_fini = KO;
-			DPT.hard.dest = DPT.sl_addr;
-			TWI_sl_rx(sizeof(frame_t) - FRAME_ORIG_OFFSET, (u8*)&DPT.hard + FRAME_ORIG_OFFSET);
+			// just provide a buffer to store the incoming burst
+			TWI_sl_rx(sizeof(DPT.rx_burst), DPT.rx_burst);
 
 			break;
 
 		case TWI_GENCALL_END:
-			// if the msg len is correct
-			if ( nb_data == (sizeof(frame_t) - FRAME_ORIG_OFFSET)) {
-				// enqueue the incoming frame
-				FIFO_put(&DPT.in_fifo, &DPT.hard);
-			}
-			// else it is ignored
+			// enqueue the frames if correct
+			DPT_rx_end(nb_data, TRUE);
 
 			// release the bus
 			TWI_stop();
-			DPT.hard_fini = OK;
 
 			break;
 
 		default:
 			// error or time-out state
-			DPT.hard.dest = DPT.sl_addr;
-			DPT.hard.resp = 1;
-			DPT.hard.time_out = 1;
+			DPT_COUNT(DPT.stats.twi_err);
 
-			// enqueue the response
-			FIFO_put(&DPT.in_fifo, &DPT.hard);
+			// if a transfer was running, it will be retried
+			if ( DPT.hard_fini != OK ) {
+				DPT.hard_err = TRUE;
+			}
 
 			// and then release the bus
 			TWI_stop();
@@ -388,6 +1494,161 @@ static void DPT_I2C_call_back(twi_state_t state, u8 nb_data, void* misc)
 }
 
 
+#ifdef DPT_ENABLE_SHAPE
+// refill the token buckets of the shaped channels
+static void DPT_shape_tick(void)
+{
+	dpt_shape_t* sh;
+	u8 i;
+
+	DPT.shape_time = TIME_get() + DPT_SHAPE_TICK;
+
+	for ( i = 0; i < DPT_CHAN_NB; i++ ) {
+		sh = &DPT.shape[i];
+
+		// if the channel is not shaped or its token is not due
+		if ( (sh->period == 0) || (++sh->count < sh->period) ) {
+			continue;
+		}
+		sh->count = 0;
+
+		if ( sh->tokens < sh->depth ) {
+			sh->tokens++;
+		}
+
+		// a throttled channel can send again
+		if ( DPT.throttled & DPT_CHAN(i) ) {
+			DPT.throttled &= ~DPT_CHAN(i);
+			DPT.ready |= DPT_CHAN(i);
+		}
+	}
+}
+
+
+// check if the frame of the channel needs a token of its bucket
+static u8 DPT_shaped(u8 channel, frame_t* fr)
+{
+	return (DPT.shape[channel].period != 0)
+			&& (fr->dest != DPT_SELF_ADDR) && (fr->dest != DPT.sl_addr);
+}
+#endif
+
+
+// refuse the frame of the channel
+// it is only counted once, not on each retry of its sender
+static u8 DPT_refuse(u8 channel)
+{
+#ifdef DPT_ENABLE_STATS
+	if ( !(DPT.refused & DPT_CHAN(channel)) ) {
+		DPT.refused |= DPT_CHAN(channel);
+		DPT_COUNT(DPT.chan_stats[channel].refused);
+	}
+#else
+	(void)channel;
+#endif
+
+	return KO;
+}
+
+
+// queue the frame on the channel of the interface
+// if call is not NULL, the request is recorded as a call
+// and its transaction index is given back
+static u8 DPT_send(dpt_interface_t* interf, frame_t* fr, u32 time_out, u8* call)
+{
+	frame_t* slot;
+	u8 i;
+
+	// if the sender is not registered
+	if ( interf->channel >= DPT_CHAN_NB ) {
+		return KO;
+	}
+
+#ifdef DPT_ENABLE_SHAPE
+	// if the frame leaves the node while the channel bucket is empty
+	if ( DPT_shaped(interf->channel, fr) && (DPT.shape[interf->channel].tokens == 0) ) {
+		// the sender shall retry when a token is back
+		// the frame is counted when the channel gets throttled
+		if ( !(DPT.throttled & DPT_CHAN(interf->channel)) ) {
+			DPT.throttled |= DPT_CHAN(interf->channel);
+			if ( DPT.shape[interf->channel].throttled != 0xffff ) {
+				DPT.shape[interf->channel].throttled++;
+			}
+		}
+		return KO;
+	}
+#endif
+
+	// if the channel emission queue is full
+	if ( DPT.tx_nb[interf->channel] >= NB_TX_FRAMES ) {
+		// the sender shall retry when the queue gets room
+		return DPT_refuse(interf->channel);
+	}
+
+	// get a free frame slot
+	slot = DPT_alloc();
+	if ( slot == NULL ) {
+		// the sender shall retry on its next run
+		DPT.ready |= DPT_CHAN(interf->channel);
+		return DPT_refuse(interf->channel);
+	}
+
+	// if the frame is not a response
+	if ( !fr->resp ) {
+		// increment transaction id
+		DPT.t_id++;
+
+		// and set it in the current frame
+		fr->t_id = DPT.t_id;
+
+		// its response is awaited by the channel
+		i = DPT_trans_add(interf->channel, fr, time_out, call != NULL);
+
+		// a call can't be done without its transaction
+		if ( call != NULL ) {
+			if ( i == DPT_NO_TRANS ) {
+				// the sender shall retry on its next run
+				DPT_free(slot);
+				DPT.ready |= DPT_CHAN(interf->channel);
+				return DPT_refuse(interf->channel);
+			}
+			*call = i;
+		}
+	}
+
+#ifdef DPT_ENABLE_STATS
+	// the frame is accepted
+	DPT.refused &= ~DPT_CHAN(interf->channel);
+#endif
+
+	// the frame is copied once for all in the slot
+	*slot = *fr;
+
+	// if the frame is for the local node only
+	// and no frame of higher or same priority is waiting
+	if ( ( (fr->dest == DPT_SELF_ADDR) || (fr->dest == DPT.sl_addr) )
+			&& !(DPT.tx_pending & DPT_CHAN_UPTO(interf->channel)) ) {
+		// give it to the receivers right now
+		DPT_dispatch(slot);
+		DPT_free(slot);
+
+		return OK;
+	}
+
+	// else it is queued on its channel
+	DPT_tx_put(interf->channel, slot);
+
+#ifdef DPT_ENABLE_SHAPE
+	// and uses a token if needed
+	if ( DPT_shaped(interf->channel, fr) ) {
+		DPT.shape[interf->channel].tokens--;
+	}
+#endif
+
+	return OK;
+}
+
+
 //----------------------------------------
 // public functions
 //
@@ -397,27 +1658,75 @@ void DPT_init(void)
 {
 	u8 i;
 
-	// channels and lock reset
+	// channels reset
 	for ( i = 0; i < DPT_CHAN_NB; i++ ) {
 		DPT.channels[i] = NULL;
 	}
-	DPT.lock = 0;
+#ifdef DPT_ENABLE_FANOUT
+	memset(DPT.fanout, 0, sizeof(DPT.fanout));
+#endif
+	DPT.high = 0;
+
+	// nothing to run
+	DPT.ready = 0;
+	for ( i = 0; i < DPT_CHAN_NB; i++ ) {
+		DPT.wake_time[i] = TIME_MAX;
+	}
+
+	// no request is waiting for its response
+	for ( i = 0; i < NB_TRANS; i++ ) {
+		DPT.trans[i].channel = DPT_NO_CHAN;
+	}
+	DPT.trans_time = TIME_MAX;
+
+	// every frame slot is free
+	for ( i = 0; i < NB_POOL_FRAMES; i++ ) {
+		DPT.pool[i].ref = 0;
+	}
 
 	// appli thread init
-	FIFO_init(&DPT.appli_fifo, &DPT.appli_buf, NB_APPLI_FRAMES, sizeof(frame_t));
+	memset(DPT.tx_nb, 0, sizeof(DPT.tx_nb));
+	DPT.tx_pending = 0;
 	PT_INIT(&DPT.appli_pt);
 
 	// in thread init
-	FIFO_init(&DPT.in_fifo, &DPT.in_buf, NB_IN_FRAMES, sizeof(frame_t));
+	FIFO_init(&DPT.in_fifo, &DPT.in_buf, NB_IN_FRAMES, sizeof(DPT.in_buf[0]));
+	DPT.rx_head = 0;
+	DPT.rx_tail = 0;
+#ifdef DPT_ENABLE_DUP
+	// the recorded requests are all out of their window
+	for ( i = 0; i < NB_DUP; i++ ) {
+		DPT.dup[i].time = TIME_get() - DPT_DUP_WINDOW;
+	}
+	DPT.dup_idx = 0;
+#endif
 	PT_INIT(&DPT.in_pt);
 
 	// out thread init
 	DPT.sl_addr = DPT_SELF_ADDR;
+	DPT.groups = 0;
 	DPT.time_out = TIME_MAX;
-	FIFO_init(&DPT.out_fifo, &DPT.out_buf, NB_OUT_FRAMES, sizeof(frame_t));
+	DPT.nb_out = 0;
 	PT_INIT(&DPT.out_pt);
+	DPT.nb_hard = 0;
 	DPT.hard_fini = OK;
 
+#ifdef DPT_ENABLE_SHAPE
+	// no bandwidth limit
+	memset(DPT.shape, 0, sizeof(DPT.shape));
+	DPT.throttled = 0;
+	DPT.shape_time = TIME_get() + DPT_SHAPE_TICK;
+#endif
+
+#ifdef DPT_ENABLE_STATS
+	// statistics reset
+	DPT.refused = 0;
+	memset(DPT.chan_stats, 0, sizeof(DPT.chan_stats));
+	memset(&DPT.stats, 0, sizeof(DPT.stats));
+	memset(DPT.retry_addr, 0, sizeof(DPT.retry_addr));
+	memset(DPT.retry_cnt, 0, sizeof(DPT.retry_cnt));
+#endif
+
 	// start TWI layer
 	TWI_init(DPT_I2C_call_back, NULL);
 }
@@ -428,13 +1737,32 @@ void DPT_run(void)
 {
 	// if current time is above the computed time-out
 	if ( (TIME_get() > DPT.time_out) && (DPT.hard_fini != OK) ) {
+		DPT_COUNT(DPT.stats.time_out);
+
 		cli();
-		DPT.hard.time_out = 1;
 		// fake an interrupt with twi layer error
 		DPT_I2C_call_back(TWI_ERROR, 0, NULL);
 		sei();
 	}
 
+	// if a response deadline is elapsed
+	if ( TIME_get() > DPT.trans_time ) {
+		DPT_trans_expire();
+	}
+
+#ifdef DPT_ENABLE_SHAPE
+	// if the token buckets shall be refilled
+	if ( TIME_get() > DPT.shape_time ) {
+		DPT_shape_tick();
+	}
+#endif
+
+	// if no frame is waiting nor being sent
+	if ( !DPT.tx_pending && (DPT.rx_head == DPT.rx_tail) && !FIFO_full(&DPT.in_fifo) && (DPT.nb_out == 0) && (DPT.nb_hard == 0) ) {
+		// the threads have nothing to do
+		return;
+	}
+
 	(void)PT_SCHEDULE(DPT_out(&DPT.out_pt));
 	(void)PT_SCHEDULE(DPT_in(&DPT.in_pt));
 	(void)PT_SCHEDULE(DPT_appli(&DPT.appli_pt));
@@ -488,53 +1816,355 @@ void DPT_register(dpt_interface_t* interf)
 
 	// set the available channel
 	interf->channel = i;
+
+	// add the channel to the subscribers of its commands
+	DPT_fanout_update(i, interf->cmde_mask);
+
+	// let the application run once
+	DPT.ready |= DPT_CHAN(i);
 }
 
 
+
 void DPT_lock(dpt_interface_t* interf)
 {
-	// set the lock bit associated to the channel
-	DPT.lock |= 1 << interf->channel;
+	// nothing to do, the channel priority gives the emission order
+	(void)interf;
 }
 
 
 void DPT_unlock(dpt_interface_t* interf)
 {
-	// reset the lock bit associated to the channel
-	DPT.lock &= ~(1 << interf->channel);
+	// nothing to do, the channel priority gives the emission order
+	(void)interf;
 }
 
 
 u8 DPT_tx(dpt_interface_t* interf, frame_t* fr)
 {
-	u8 i;
+	return DPT_send(interf, fr, DPT_TRANS_TIME_OUT, NULL);
+}
+
+
+u8 DPT_call(dpt_interface_t* interf, frame_t* fr, u32 time_out, u8* call)
+{
+	return DPT_send(interf, fr, time_out, call);
+}
+
+
+u8 DPT_call_done(dpt_interface_t* interf, u8 call, frame_t* fr)
+{
+	dpt_trans_t* tr;
+
+	// if the call is unknown
+	if ( call >= NB_TRANS ) {
+		return KO;
+	}
+	tr = &DPT.trans[call];
+
+	// if the call is not the one of the interface or not answered yet
+	if ( (tr->channel != interf->channel) || !tr->is_call || (tr->resp == NULL) ) {
+		return KO;
+	}
+
+	// copy the response and release the call
+	*fr = *tr->resp;
+	DPT_free(tr->resp);
+	tr->resp = NULL;
+	tr->channel = DPT_NO_CHAN;
+
+	return OK;
+}
+
 
-	// if the tx is locked by a channel of higher priority
-	for ( i = 0; (i < DPT_CHAN_NB) && (i < interf->channel); i++ ) {
-		if ( DPT.lock & (1 << i) ) {
-			// the sender shall retry
-			// so return KO
+u8 DPT_rx(dpt_interface_t* interf, frame_t* fr)
+{
+	frame_t* ref;
+
+	// if no frame is received
+	if ( KO == FIFO_get(interf->queue, &ref) ) {
+		return KO;
+	}
+
+	// copy it and release the shared one
+	*fr = *ref;
+	DPT_free(ref);
+
+	return OK;
+}
+
+
+u8 DPT_ready(dpt_interface_t* interf)
+{
+	u8 channel = interf->channel;
+
+	// an unregistered application is always run
+	if ( channel >= DPT_CHAN_NB ) {
+		return OK;
+	}
+
+	// if woken, if a frame is waiting or if the deadline is elapsed
+	if ( (DPT.ready & DPT_CHAN(channel))
+			|| ( (interf->queue != NULL) && FIFO_full(interf->queue) )
+			|| ( (DPT.wake_time[channel] != TIME_MAX) && (TIME_get() > DPT.wake_time[channel]) ) ) {
+		// it is taken out of the run queue
+		DPT.ready &= ~DPT_CHAN(channel);
+		DPT.wake_time[channel] = TIME_MAX;
+
+		return OK;
+	}
+
+	return KO;
+}
+
+
+void DPT_wake(dpt_interface_t* interf)
+{
+	if ( interf->channel < DPT_CHAN_NB ) {
+		DPT.ready |= DPT_CHAN(interf->channel);
+	}
+}
+
+
+void DPT_wake_at(dpt_interface_t* interf, u32 time)
+{
+	// keep the nearest deadline
+	if ( (interf->channel < DPT_CHAN_NB) && (time < DPT.wake_time[interf->channel]) ) {
+		DPT.wake_time[interf->channel] = time;
+	}
+}
+
+
+void DPT_free(frame_t* fr)
+{
+	// release one reference on the frame slot
+	if ( (fr != NULL) && DPT_SLOT(fr)->ref ) {
+		DPT_SLOT(fr)->ref--;
+	}
+}
+
+
+u8 DPT_stats(frame_t* fr)
+{
+#ifdef DPT_ENABLE_STATS
+	dpt_chan_stats_t* chan;
+	u16 cnt[2];
+	u8 set = fr->argv[0] & ~FR_DPT_STATS_RESET;
+	u8 idx = fr->argv[1];
+
+	switch ( set ) {
+		case FR_DPT_STATS_CHAN:
+		case FR_DPT_STATS_TX:
+			if ( idx >= DPT_CHAN_NB ) {
+				return KO;
+			}
+			chan = &DPT.chan_stats[idx];
+
+			if ( set == FR_DPT_STATS_CHAN ) {
+				cnt[0] = chan->delivered;
+				cnt[1] = chan->dropped;
+			}
+			else {
+				cnt[0] = chan->refused;
+				cnt[1] = (chan->rx_hwm << 8) | chan->tx_hwm;
+			}
+
+			if ( fr->argv[0] & FR_DPT_STATS_RESET ) {
+				memset(chan, 0, sizeof(dpt_chan_stats_t));
+			}
+			break;
+
+		case FR_DPT_STATS_TWI:
+			cnt[0] = DPT.stats.twi_err;
+			cnt[1] = DPT.stats.no_sl;
+
+			if ( fr->argv[0] & FR_DPT_STATS_RESET ) {
+				DPT.stats.twi_err = 0;
+				DPT.stats.no_sl = 0;
+			}
+			break;
+
+		case FR_DPT_STATS_LOST:
+			cnt[0] = DPT.stats.time_out;
+			cnt[1] = DPT.stats.lost;
+
+			if ( fr->argv[0] & FR_DPT_STATS_RESET ) {
+				DPT.stats.time_out = 0;
+				DPT.stats.lost = 0;
+			}
+			break;
+
+		case FR_DPT_STATS_HWM:
+			cnt[0] = (DPT.stats.in_hwm << 8) | DPT.stats.out_hwm;
+			cnt[1] = DPT.stats.pool_hwm << 8;
+
+			if ( fr->argv[0] & FR_DPT_STATS_RESET ) {
+				DPT.stats.in_hwm = 0;
+				DPT.stats.out_hwm = 0;
+				DPT.stats.pool_hwm = 0;
+			}
+			break;
+
+		case FR_DPT_STATS_DUP:
+			cnt[0] = DPT.stats.dup;
+			cnt[1] = 0;
+
+			if ( fr->argv[0] & FR_DPT_STATS_RESET ) {
+				DPT.stats.dup = 0;
+			}
+			break;
+
+		case FR_DPT_STATS_RETRY:
+			if ( idx >= NB_RETRY_STATS ) {
+				return KO;
+			}
+			cnt[0] = DPT.retry_addr[idx] << 8;
+			cnt[1] = DPT.retry_cnt[idx];
+
+			if ( fr->argv[0] & FR_DPT_STATS_RESET ) {
+				DPT.retry_cnt[idx] = 0;
+			}
+			break;
+
+		default:
 			return KO;
-		}
 	}
 
-	// if the sender didn't lock the channel
-	if ( !(DPT.lock & (1 << interf->channel)) ) {
-		// it can't send the frame
+	// counters MSB first
+	fr->argv[2] = (u8)(cnt[0] >> 8);
+	fr->argv[3] = (u8)(cnt[0] >> 0);
+	fr->argv[4] = (u8)(cnt[1] >> 8);
+	fr->argv[5] = (u8)(cnt[1] >> 0);
+
+	return OK;
+#else
+	(void)fr;
+
+	return KO;
+#endif
+}
+
+
+u8 DPT_shape(frame_t* fr)
+{
+#ifdef DPT_ENABLE_SHAPE
+	dpt_shape_t* sh;
+	u16 cnt;
+	u8 channel = fr->argv[0];
+
+	if ( channel >= DPT_CHAN_NB ) {
 		return KO;
 	}
+	sh = &DPT.shape[channel];
+
+	switch ( fr->argv[1] ) {
+		case FR_DPT_SHAPE_SET:
+			// the bucket starts full
+			sh->period = fr->argv[2];
+			sh->depth = fr->argv[3];
+			sh->tokens = sh->depth;
+			sh->count = 0;
+			sh->throttled = 0;
+
+			// a throttled channel is no more limited by the previous setting
+			if ( DPT.throttled & DPT_CHAN(channel) ) {
+				DPT.throttled &= ~DPT_CHAN(channel);
+				DPT.ready |= DPT_CHAN(channel);
+			}
+			break;
 
-	// if the frame is not a response
-	if ( !fr->resp ) {
-		// increment transaction id
-		DPT.t_id++;
+		case FR_DPT_SHAPE_GET:
+			fr->argv[2] = sh->period;
+			fr->argv[3] = sh->depth;
+			break;
 
-		// and set it in the current frame
-		fr->t_id = DPT.t_id;
+		default:
+			return KO;
+	}
+
+	// throttled frames counter MSB first
+	cnt = sh->throttled;
+	fr->argv[4] = (u8)(cnt >> 8);
+	fr->argv[5] = (u8)(cnt >> 0);
+
+	return OK;
+#else
+	(void)fr;
+
+	return KO;
+#endif
+}
+
+
+u8 DPT_retries(u8 index, u8* addr, u16* cnt)
+{
+#ifdef DPT_ENABLE_STATS
+	if ( index >= NB_RETRY_STATS ) {
+		return KO;
+	}
+
+	*addr = DPT.retry_addr[index];
+	*cnt = DPT.retry_cnt[index];
+
+	return OK;
+#else
+	(void)index;
+	(void)addr;
+	(void)cnt;
+
+	return KO;
+#endif
+}
+
+
+u8 DPT_join(u8 group)
+{
+	if ( !DPT_IS_GROUP(group) ) {
+		return KO;
+	}
+
+	DPT.groups |= 1 << (group - DPT_GROUP_FIRST_ADDR);
+
+	return OK;
+}
+
+
+u8 DPT_leave(u8 group)
+{
+	if ( !DPT_IS_GROUP(group) ) {
+		return KO;
+	}
+
+	DPT.groups &= ~(1 << (group - DPT_GROUP_FIRST_ADDR));
+
+	return OK;
+}
+
+
+u8 DPT_group(frame_t* fr)
+{
+	u8 res = OK;
+
+	switch ( fr->argv[1] ) {
+		case FR_DPT_GROUP_JOIN:
+			res = DPT_join(fr->argv[0]);
+			break;
+
+		case FR_DPT_GROUP_LEAVE:
+			res = DPT_leave(fr->argv[0]);
+			break;
+
+		case FR_DPT_GROUP_GET:
+			break;
+
+		default:
+			return KO;
 	}
 
-	// try to enqueue the frame
-	return FIFO_put(&DPT.appli_fifo, fr);
+	// joined groups bitfield
+	fr->argv[2] = DPT.groups;
+
+	return res;
 }
 
 
@@ -543,6 +2173,9 @@ void DPT_set_sl_addr(u8 addr)
 	// save slave address
 	DPT.sl_addr = addr;
 
+	// masters sharing the bus draw different backoffs
+	srand(addr);
+
 	// set slave address at TWI level
 	TWI_set_sl_addr(addr);
 }
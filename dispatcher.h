@@ -15,8 +15,8 @@
 // the dispatcher offers several prioritized channels to
 // which the applications shall register (1 appli <=> 1 channel)
 //
-// the prioritized channels permit to block applications
-// while sensible activity is proceeded.
+// each channel has its own emission queue and
+// the frames of the highest priority channel are always sent first.
 //
 // the dispatcher defines specific frame format.
 // thanks to this format, the dispatcher can distribute
@@ -24,6 +24,8 @@
 //
 // the dispatcher treats the sent frames one after the other.
 //
+// the received frames are shared by every receiver,
+// so the queues only carry references on them (frame_t*).
 //
 
 
@@ -42,15 +44,43 @@
 // public defines
 //
 
-# define DPT_CHAN_NB	12				// dispatcher available channels number
+// configuration flags to reduce memory usage
+//#define DPT_ENABLE_STATS		// traffic statistics (FR_DPT_STATS)
+//#define DPT_ENABLE_SHAPE		// channels bandwidth shaping (FR_DPT_SHAPE)
+//#define DPT_ENABLE_DUP		// drop the copies of the received requests
+//#define DPT_ENABLE_FANOUT		// subscribed channels table of the first commands
+
+# ifndef DPT_CHAN_NB
+#  define DPT_CHAN_NB	12				// dispatcher available channels number (up to 32)
+# endif
+
+// total size of the reception queues of the applications
+// other than the library modules (counted by the dispatcher itself)
+# ifndef DPT_APP_FRAMES
+#  define DPT_APP_FRAMES	0
+# endif
 
 # define DPT_BROADCAST_ADDR	0x00		// frame broadcast address
 # define DPT_SELF_ADDR		0x01		// reserved I2C address used for generic local node
 # define DPT_FIRST_ADDR		0x02		// first I2C address
 # define DPT_LAST_ADDR		0x7f		// last I2C address
 
+# define DPT_GROUP_FIRST_ADDR	0x80	// first multicast group address
+# define DPT_GROUP_NB		8			// multicast groups number
+
+# ifndef DPT_RETRY_MAX
+#  define DPT_RETRY_MAX		8			// failed twi transfer retries before giving up
+# endif
+# define DPT_BACKOFF_SHIFT_MAX	5		// retry delay window up to 32 ms
 
-#define _CM(x)		(u64)(1LL << (x))	// compute command mask
+// longest delay in ms spent waiting between the retries of a twi transfer
+// (the window doubles at each retry up to its maximum)
+# define DPT_RETRY_TIME		( (DPT_RETRY_MAX <= DPT_BACKOFF_SHIFT_MAX)	\
+		? ((2 << DPT_RETRY_MAX) - 2)	\
+		: ((2 << DPT_BACKOFF_SHIFT_MAX) - 2 + (DPT_RETRY_MAX - DPT_BACKOFF_SHIFT_MAX) * (1 << DPT_BACKOFF_SHIFT_MAX)) )
+
+
+#define DPT_IS_GROUP(addr)	( ((addr) >= DPT_GROUP_FIRST_ADDR) && ((addr) < DPT_GROUP_FIRST_ADDR + DPT_GROUP_NB) )
 
 
 //----------------------------------------
@@ -59,8 +89,8 @@
 
 typedef struct {
 	u8 channel;			// requested channel
-	u64 cmde_mask;		// bit mask for frame filtering
-	fifo_t* queue;		// queue filled by received frames
+	const u8* cmde_mask;	// command filter bitmap in flash (FR_MASK_xxx), NULL for none
+	fifo_t* queue;		// queue filled by received frames references (frame_t*)
 } dpt_interface_t;
 
 
@@ -108,43 +138,161 @@ extern void DPT_run(void);
 //  - the requested channel
 //  - the command range that is used to transmit the received frame to the application : the low and high values are inclusive
 //  - the command mask only authorizes the commands corresponding to the set bits
+//		it is a bitmap of the 256 commands stored in flash, generated by frame.py (FR_MASK_xxx)
 //  - the queue is filled by the dispatcher when a frame is received 
-//		(the associated channel is locked if the frame is enqueued)
+//		its elements are frame references (frame_t*)
 //
 // the available channel is directly set in the structure
 // if it is 0xff, it means no more channel are available
+//
+// the command mask is compiled at registration
+// in a table giving the subscribed channels of the first commands
+// so it can't be changed afterwards
+// (a module filtering at runtime keeps its own filter, see log.c)
 extern void DPT_register(dpt_interface_t* interf);
 
 
-// dispatcher channel lock
+// dispatcher channel lock and unlock
 //
-// lock the given channel for exclusive use
-// only channel with lower value
-// (i.e. higher priority) shall be able to
-// send frames.
+// they do nothing and are only kept for API compatibility :
+// the emission order is given by the channel priority,
+// so a channel never blocks the channels
+// with lower priority while it has nothing to send.
 extern void DPT_lock(dpt_interface_t* interf);
-
-
-// dispatcher channel unlock
-//
-// unlock the given channel
-// channels with lower priority will
-// be able to send frames
 extern void DPT_unlock(dpt_interface_t* interf);
 
 
 // dispatcher frame sending function
 //
 // request a frame to be sent
-// if a frame can't be sent,
+// the frame is queued on the channel of the interface
+// and the queues are emptied by order of channel priority
+// if the frame is a request (not broadcast), its response
+// will only be given to this channel.
+// if no response is received in time, the request is forgotten
+// and a late response is given to every subscriber.
+// if a frame can't be queued (queue full or no free frame),
 // KO is returned and sending the frame
 // must be retried
-// if a frame can't be sent, it probably
-// means the channel is not locked or
-// a channel of higher priority is locked
 extern u8 DPT_tx(dpt_interface_t* interf, frame_t* frame);
 
 
+// dispatcher call function
+//
+// send the request frame like DPT_tx()
+// and keep its response apart from the interface queue
+// the response is awaited until the given time-out,
+// then a response with the time_out flag set is given instead.
+// the call index to give to DPT_call_done() is set in call.
+// KO is returned if the frame can't be queued or
+// if too many requests are awaiting their response,
+// so the call must be retried.
+extern u8 DPT_call(dpt_interface_t* interf, frame_t* frame, u32 time_out, u8* call);
+
+
+// dispatcher call completion function
+//
+// if the response of the call is received,
+// copy it in the given frame, release the call and return OK
+// else KO is returned
+// every call shall be completed to release its resources
+//
+// typical use in a thread :
+//	PT_WAIT_UNTIL(pt, DPT_call(&interf, &fr, time_out, &call));
+//	...
+//	PT_WAIT_UNTIL(pt, DPT_call_done(&interf, call, &fr));
+extern u8 DPT_call_done(dpt_interface_t* interf, u8 call, frame_t* frame);
+
+
+// dispatcher frame reception function
+//
+// dequeue a received frame from the interface queue
+// copy it in the given frame and release the shared one
+// if no frame is received, KO is returned
+extern u8 DPT_rx(dpt_interface_t* interf, frame_t* frame);
+
+
+// dispatcher run queue test function
+//
+// return OK if the application of the interface has something to do :
+//  - a frame is waiting in its queue
+//  - its emission queue got room again or a frame could not be sent
+//  - its deadline is elapsed
+//  - it was woken
+// then it is taken out of the run queue and its deadline is cleared,
+// so the deadline shall be set again after each run
+// if KO is returned, the application threads can be skipped
+extern u8 DPT_ready(dpt_interface_t* interf);
+
+
+// dispatcher wake up function
+//
+// put the application back in the run queue
+// (e.g. while it is waiting for a driver)
+extern void DPT_wake(dpt_interface_t* interf);
+
+
+// dispatcher deadline function
+//
+// the application will be ready once the given time is elapsed
+// only the nearest deadline is kept
+extern void DPT_wake_at(dpt_interface_t* interf, u32 time);
+
+
+// dispatcher frame release function
+//
+// a frame reference taken from the interface queue
+// can be read in place (it shall not be modified)
+// but it must be released once it is no more used
+extern void DPT_free(frame_t* frame);
+
+
+// dispatcher statistics function
+//
+// fill the response arguments of a FR_DPT_STATS frame
+// with the counters set given in its arguments
+// KO is returned if the set or the index is invalid
+// or if the statistics are not enabled (DPT_ENABLE_STATS)
+extern u8 DPT_stats(frame_t* frame);
+
+
+// dispatcher bandwidth shaping function
+//
+// set or get the token bucket of the channel given in a FR_DPT_SHAPE frame
+// and give its throttled frames counter in the response arguments
+// a channel with a null token period has no bandwidth limit
+// KO is returned if the channel or the sub-command is invalid
+// or if the shaping is not enabled (DPT_ENABLE_SHAPE)
+extern u8 DPT_shape(frame_t* frame);
+
+
+// dispatcher retry statistics function
+//
+// give the destination and the number of twi transfer retries
+// of the given entry of the most retried destinations
+// KO is returned when the index is out of range
+// or if the statistics are not enabled (DPT_ENABLE_STATS)
+extern u8 DPT_retries(u8 index, u8* addr, u16* cnt);
+
+
+// dispatcher multicast group membership functions
+//
+// the frames sent to a multicast group address
+// are sent once to every node with a general call
+// and only the nodes which joined the group receive them
+// KO is returned if the address is not a group one
+extern u8 DPT_join(u8 group);
+extern u8 DPT_leave(u8 group);
+
+
+// dispatcher multicast group command function
+//
+// join, leave or get the groups of a FR_DPT_GROUP frame
+// and give the joined groups bitfield in its response arguments
+// KO is returned if the group or the sub-command is invalid
+extern u8 DPT_group(frame_t* frame);
+
+
 // dispatcher set TWI slave address function
 //
 void DPT_set_sl_addr(u8 addr);
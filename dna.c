@@ -37,7 +37,8 @@
 
 #define PCA9540B_ADDR	0x70	// I2C mux
 
-#define NB_IN			3		// incoming frames buffer size
+
+#define DNA_RESP_TIME_OUT	((DPT_RETRY_TIME + 100) * TIME_1_MSEC)	// scanning response time-out (after the dispatcher retries)
 
 //--------------------------------------
 // private enums
@@ -66,9 +67,10 @@ static struct {
 	u8 index;					// index in current sending of the list
 
 	fifo_t in_fifo;				// incoming frames fifo
-	frame_t in_buf[NB_IN];		// incoming frames buffer
+	frame_t* in_buf[DNA_NB_IN];		// incoming frames buffer
 
 	frame_t out;				// out going frame
+	u8 call;					// scanning request
 
 	u8 tmp;						// all purpose temporary buffer
 
@@ -109,12 +111,12 @@ static PT_THREAD( DNA_scan_free(pt_t* pt, u8 is_bc) )
 		}
 
 		// then send frame
-		PT_WAIT_UNTIL(pt, DPT_tx(&DNA.interf, &DNA.out) == OK);
+		PT_WAIT_UNTIL(pt, DPT_call(&DNA.interf, &DNA.out, DNA_RESP_TIME_OUT, &DNA.call) == OK);
 
-		// wait for the matching response evicting the others
-		PT_WAIT_UNTIL(pt, (OK == FIFO_get(&DNA.in_fifo, &fr)) && (fr.t_id == DNA.out.t_id) );
+		// wait for its response
+		PT_WAIT_UNTIL(pt, DPT_call_done(&DNA.interf, DNA.call, &fr));
 
-		if ( (fr.cmde == FR_I2C_READ) && fr.resp && fr.error ) {
+		if ( (fr.cmde == FR_I2C_READ) && fr.resp && fr.error && !fr.time_out ) {
 			// a free address is found
 			DNA_SELF_ADDR(DNA.list) = DNA.tmp;
 
@@ -124,7 +126,8 @@ static PT_THREAD( DNA_scan_free(pt_t* pt, u8 is_bc) )
 			PT_EXIT(pt);
 		}
 
-		if ( (fr.cmde == FR_I2C_READ) && fr.resp ) {
+		// on a time-out, the same address is tried again
+		if ( (fr.cmde == FR_I2C_READ) && fr.resp && !fr.time_out ) {
 			// the address is in use
 			// try the next one
 			DNA.tmp++;
@@ -162,10 +165,15 @@ static PT_THREAD( DNA_scan_bs(pt_t* pt) )
 		DNA.out.cmde = FR_I2C_READ;
 
 		// then send frame
-		PT_WAIT_UNTIL(pt, DPT_tx(&DNA.interf, &DNA.out) == OK);
+		PT_WAIT_UNTIL(pt, DPT_call(&DNA.interf, &DNA.out, DNA_RESP_TIME_OUT, &DNA.call) == OK);
 
-		// wait for the matching response evicting the others
-		PT_WAIT_UNTIL(pt, (OK == FIFO_get(&DNA.in_fifo, &fr)) && (fr.t_id == DNA.out.t_id) );
+		// wait for its response
+		PT_WAIT_UNTIL(pt, DPT_call_done(&DNA.interf, DNA.call, &fr));
+
+		// on a time-out, the same address is tried again
+		if ( fr.time_out ) {
+			continue;
+		}
 
 		if ( (fr.cmde == FR_I2C_READ) && fr.resp && !fr.error ) {
 			// a new BS is found
@@ -268,7 +276,7 @@ static PT_THREAD( DNA_bc_frame(pt_t* pt) )
 	PT_BEGIN(pt);
 
 	// wait incoming command
-	PT_WAIT_UNTIL(pt, OK == FIFO_get(&DNA.in_fifo, &fr));
+	PT_WAIT_UNTIL(pt, OK == DPT_rx(&DNA.interf, &fr));
 
 	// if frame is a response
 	if ( fr.resp ) {
@@ -376,7 +384,7 @@ static PT_THREAD( DNA_is_reg_wait(pt_t* pt, u8* ret) )
 	PT_BEGIN(pt);
 
 	// wait for the time-out or the reception of the response
-	PT_WAIT_UNTIL(pt, (time_out = (TIME_get() >= DNA.time)) || (OK == (*ret = FIFO_get(&DNA.in_fifo, &fr))) );
+	PT_WAIT_UNTIL(pt, (time_out = (TIME_get() >= DNA.time)) || (OK == (*ret = DPT_rx(&DNA.interf, &fr))) );
 
 	// if time-out occured
 	if (time_out) {
@@ -464,7 +472,7 @@ static PT_THREAD( DNA_is(pt_t* pt) )
 	PT_BEGIN(pt);
 
 	// wait incoming commands
-	PT_WAIT_UNTIL(pt, OK == FIFO_get(&DNA.in_fifo, &fr));
+	PT_WAIT_UNTIL(pt, OK == DPT_rx(&DNA.interf, &fr));
 
 	// immediatly release the channel
 	DPT_unlock(&DNA.interf);
@@ -527,11 +535,11 @@ void DNA_init(dna_t mode)
 	DNA_SELF_TYPE(DNA.list) = mode;
 
 	// set fifoes
-	FIFO_init(&DNA.in_fifo, &DNA.in_buf, NB_IN, sizeof(DNA.in_buf[0]));
+	FIFO_init(&DNA.in_fifo, &DNA.in_buf, DNA_NB_IN, sizeof(DNA.in_buf[0]));
 
 	// register to the dispatcher
 	DNA.interf.channel = 2;
-	DNA.interf.cmde_mask = _CM(FR_DNA_REGISTER) | _CM(FR_DNA_LIST) | _CM(FR_DNA_LINE) | _CM(FR_I2C_WRITE) | _CM(FR_I2C_READ);
+	DNA.interf.cmde_mask = FR_MASK_DNA;
 	DNA.interf.queue = &DNA.in_fifo;
 	DPT_register(&DNA.interf);
 
@@ -159,6 +159,11 @@ then addresses starting with 0 are prioritary upon the others
 // total size of the DNA I2C registered nodes
 # define DNA_LIST_SIZE		10	// only 8 IS + BS as index 0 is for self and 1 for BC
 
+// incoming frames buffer size
+# ifndef DNA_NB_IN
+#  define DNA_NB_IN		3
+# endif
+
 
 //--------------------------------------
 // typedef
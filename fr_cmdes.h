@@ -19,6 +19,9 @@
 # define FRAME_STAT_OFFSET	4
 # define FRAME_ARGV_OFFSET	5
 
+// command filters size in octets (1 bit per command)
+# define FR_MASK_SIZE	32
+
 // CONTAINER
 # define PRE_1_STORAGE	0x01
 # define FLASH_STORAGE	0xff
@@ -81,12 +84,37 @@
 # define FR_LOG_CMD_SET_MSB	0x28
 # define FR_LOG_CMD_SET_LSB	0x27
 
+// ROUT_ADD
+# define FR_ROUT_LATENCY	0x02
+# define FR_ROUT_ALL	0x00
+# define FR_ROUT_ROUND_ROBIN	0x01
+# define FR_ROUT_KEEP	0xff
+
+// DPT_STATS
+# define FR_DPT_STATS_RESET	0x80
+# define FR_DPT_STATS_HWM	0x04
+# define FR_DPT_STATS_TX	0x01
+# define FR_DPT_STATS_RETRY	0x05
+# define FR_DPT_STATS_LOST	0x03
+# define FR_DPT_STATS_TWI	0x02
+# define FR_DPT_STATS_CHAN	0x00
+# define FR_DPT_STATS_DUP	0x06
+
 // LED_CMD
 # define FR_LED_GET	0xff
 # define FR_LED_OPEN	0x09
 # define FR_LED_ALIVE	0xa1
 # define FR_LED_SET	0x00
 
+// DPT_SHAPE
+# define FR_DPT_SHAPE_SET	0x00
+# define FR_DPT_SHAPE_GET	0xff
+
+// DPT_GROUP
+# define FR_DPT_GROUP_GET	0xff
+# define FR_DPT_GROUP_LEAVE	0x00
+# define FR_DPT_GROUP_JOIN	0x01
+
 
 // --------------------------------------------
 // public types
@@ -343,13 +371,17 @@ typedef enum {
 	// - 0x1a : ON to sdcard
 	// - 0x1e : ON to eeprom
 	// - 0x27 : set command filter LSB part (bitfield for AND mask)
-	// - argv #1 - #3 value : filter value (MSB first)
+	// - argv #1 - #4 value : filter value (MSB first)
+	// - argv #5 value : block of 64 commands (0x00 - 0x03)
 	// - 0x28 : set command filter MSB part (bitfield for AND mask)
-	// - argv #1 - #3 value : filter value (MSB first)
+	// - argv #1 - #4 value : filter value (MSB first)
+	// - argv #5 value : block of 64 commands (0x00 - 0x03)
 	// - 0x2e : get command filter LSB part
-	// - argv #1 - #3 resp : filter value (MSB first)
+	// - argv #1 - #4 resp : filter value (MSB first)
+	// - argv #5 value : block of 64 commands (0x00 - 0x03)
 	// - 0x2f : get command filter MSB part
-	// - argv #1 - #3 resp : filter value (MSB first)
+	// - argv #1 - #4 resp : filter value (MSB first)
+	// - argv #5 value : block of 64 commands (0x00 - 0x03)
 	// - 0x3c : set origin filter (6 values : 0x00 logs from all nodes, 0xVV logs from given node, 0xff doesn't log)
 	// - argv #1 - #6 value : filter value
 	// - 0x3f : get origin filter
@@ -358,6 +390,7 @@ typedef enum {
 	FR_ROUT_LIST = 0x1d,
 	// number of set routes
 	// argv #0 response : number of set routes
+	// argv #2 response : version of the routing table (0 if unknown)
 
 	FR_ROUT_LINE = 0x1e,
 	// retrieve a line content
@@ -365,12 +398,18 @@ typedef enum {
 	// argv #1 response : virtual address
 	// argv #2 response : routed address
 	// argv #3 response : result OK (1) or ko (0)
+	// argv #4 response : virtual address routing mode (see rout_add)
 
 	FR_ROUT_ADD = 0x1f,
 	// add a new route
 	// argv #0 request : virtual address
 	// argv #1 request : routed address
 	// argv #2 response : result OK (1) or ko (0)
+	// argv #3 request : virtual address routing mode
+	// - 0x00 : every routed address gets the frame
+	// - 0x01 : only one routed address, chosen in turn
+	// - 0x02 : only one routed address, the fastest to respond
+	// - 0xff : unchanged (every routed address for a new one)
 
 	FR_ROUT_DEL = 0x20,
 	// delete a route
@@ -422,6 +461,36 @@ typedef enum {
 	// argv #2 - #3 : MSB - LSB max value
 	// argv #4 - #5 : MSB - LSB min value
 
+	FR_DPT_STATS = 0x29,
+	// dispatcher statistics
+	// (error response unless the dispatcher is built with DPT_ENABLE_STATS)
+	// argv #0 value : counters set (| 0x80 to reset the set after reading)
+	// - 0x00 : channel counters
+	// - argv #1 value : channel
+	// - argv #2 - #3 resp : MSB - LSB frames delivered
+	// - argv #4 - #5 resp : MSB - LSB frames dropped (reception queue full)
+	// - 0x01 : channel emission counters
+	// - argv #1 value : channel
+	// - argv #2 - #3 resp : MSB - LSB frames refused (emission queue full or no free frame)
+	// - argv #4 resp : reception queue high-water mark
+	// - argv #5 resp : emission queue high-water mark
+	// - 0x02 : twi counters
+	// - argv #2 - #3 resp : MSB - LSB errors (including time-outs)
+	// - argv #4 - #5 resp : MSB - LSB no slave
+	// - 0x03 : lost frames counters
+	// - argv #2 - #3 resp : MSB - LSB twi time-outs
+	// - argv #4 - #5 resp : MSB - LSB frames lost (malformed, no free frame, fifo full)
+	// - 0x04 : dispatcher high-water marks
+	// - argv #2 resp : in fifo
+	// - argv #3 resp : out fifo
+	// - argv #4 resp : frames pool
+	// - 0x05 : retried destinations
+	// - argv #1 value : index
+	// - argv #2 resp : destination
+	// - argv #4 - #5 resp : MSB - LSB retries
+	// - 0x06 : duplicates
+	// - argv #2 - #3 resp : MSB - LSB duplicated requests dropped
+
 	FR_LED_CMD = 0x2a,
 	// set/get led blink rate
 	// argv #0 value :
@@ -435,6 +504,49 @@ typedef enum {
 	// argv #3 value :
 	// - 0xVV : high duration [0.00; 2.55] s
 
+	FR_DPT_SHAPE = 0x2b,
+	// dispatcher channel bandwidth shaping (token bucket)
+	// (error response unless the dispatcher is built with DPT_ENABLE_SHAPE)
+	// argv #0 value : channel
+	// argv #1 value :
+	// - 0x00 : set (and reset the throttled frames counter)
+	// - 0xff : get
+	// argv #2 value / resp : token period [0.01; 2.55] s (0x00 : no limit)
+	// argv #3 value / resp : bucket depth in frames
+	// argv #4 - #5 resp : MSB - LSB frames throttled
+
+	FR_DPT_GROUP = 0x2c,
+	// dispatcher multicast groups membership
+	// argv #0 value : group address [0x80; 0x87]
+	// argv #1 value :
+	// - 0x00 : leave
+	// - 0x01 : join
+	// - 0xff : get
+	// argv #2 resp : joined groups bitfield (bit 0 for group 0x80)
+
+	FR_ROUT_LOAD = 0x2d,
+	// replace the whole routing table by a block of routes
+	// each route is 3 bytes long : virtual address, routed address, routing mode (see rout_add)
+	// the table is saved in eeprom and restored at start-up
+	// argv #0-1 request : offset in memory of the first route (MSB first)
+	// argv #2 request : number of routes
+	// argv #3 request : memory type (see container)
+	// - 0xee eeprom,
+	// - 0xff flash,
+	// - 0xaa ram,
+	// argv #4 request : table version, if not null and equal to the current one, the table is not loaded
+	// argv #5 response : result OK (1) or ko (0)
+
+	FR_NAT_CREDIT = 0x2e,
+	// flow control credits of a NAT host link (serial or ethernet)
+	// the host can send as many frames as it has credits, each frame using one.
+	// the gateway sends it unsolicited to return the credits
+	// of the host frames passed on the bus (the whole window at start-up).
+	// a request from the host is answered by the gateway itself
+	// with the credits currently available.
+	// argv #0 value : number of returned credits (response : number of available credits)
+	// argv #1 value : credits window size
+
 	FR_APPLI_START = 0x3f,
 	// application start signal
 	// and last command in list
@@ -478,4 +590,14 @@ extern u8 frame_set_5(frame_t* fr, u8 dest, u8 orig, fr_cmdes_t cmde, u8 len, u8
 extern u8 frame_set_6(frame_t* fr, u8 dest, u8 orig, fr_cmdes_t cmde, u8 len, u8 argv0, u8 argv1, u8 argv2, u8 argv3, u8 argv4, u8 argv5);
 
 
+// modules command filters (stored in flash)
+extern const u8 FR_MASK_ALL[FR_MASK_SIZE];
+extern const u8 FR_MASK_BSC[FR_MASK_SIZE];
+extern const u8 FR_MASK_CMN[FR_MASK_SIZE];
+extern const u8 FR_MASK_DNA[FR_MASK_SIZE];
+extern const u8 FR_MASK_LOG[FR_MASK_SIZE];
+extern const u8 FR_MASK_RCF[FR_MASK_SIZE];
+extern const u8 FR_MASK_ROUT[FR_MASK_SIZE];
+
+
 #endif	// __FRAMES_H__
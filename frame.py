@@ -910,13 +910,17 @@ class log_cmd(Frame):
 		- 0x1a : ON to sdcard
 		- 0x1e : ON to eeprom
 		- 0x27 : set command filter LSB part (bitfield for AND mask)
-			- argv #1 - #3 value : filter value (MSB first)
+			- argv #1 - #4 value : filter value (MSB first)
+			- argv #5 value : block of 64 commands (0x00 - 0x03)
 		- 0x28 : set command filter MSB part (bitfield for AND mask)
-			- argv #1 - #3 value : filter value (MSB first)
+			- argv #1 - #4 value : filter value (MSB first)
+			- argv #5 value : block of 64 commands (0x00 - 0x03)
 		- 0x2e : get command filter LSB part
-			- argv #1 - #3 resp : filter value (MSB first)
+			- argv #1 - #4 resp : filter value (MSB first)
+			- argv #5 value : block of 64 commands (0x00 - 0x03)
 		- 0x2f : get command filter MSB part
-			- argv #1 - #3 resp : filter value (MSB first)
+			- argv #1 - #4 resp : filter value (MSB first)
+			- argv #5 value : block of 64 commands (0x00 - 0x03)
 		- 0x3c : set origin filter (6 values : 0x00 logs from all nodes, 0xVV logs from given node, 0xff doesn't log)
 			- argv #1 - #6 value : filter value
 		- 0x3f : get origin filter
@@ -945,6 +949,7 @@ class rout_list(Frame):
 	"""
 	number of set routes
 	argv #0 response : number of set routes
+	argv #2 response : version of the routing table (0 if unknown)
 	"""
 	cmde = 0x1d
 	def __init__(self, dest, orig, t_id, stat, *argv):
@@ -958,6 +963,7 @@ class rout_line(Frame):
 	argv #1 response : virtual address
 	argv #2 response : routed address
 	argv #3 response : result OK (1) or ko (0)
+	argv #4 response : virtual address routing mode (see rout_add)
 	"""
 	cmde = 0x1e
 	def __init__(self, dest, orig, t_id, stat, *argv):
@@ -970,8 +976,21 @@ class rout_add(Frame):
 	argv #0 request : virtual address
 	argv #1 request : routed address
 	argv #2 response : result OK (1) or ko (0)
+	argv #3 request : virtual address routing mode
+		- 0x00 : every routed address gets the frame
+		- 0x01 : only one routed address, chosen in turn
+		- 0x02 : only one routed address, the fastest to respond
+		- 0xff : unchanged (every routed address for a new one)
 	"""
 	cmde = 0x1f
+
+	defines = { 
+		'FR_ROUT_ALL':'0x00',
+		'FR_ROUT_ROUND_ROBIN':'0x01',
+		'FR_ROUT_LATENCY':'0x02',
+		'FR_ROUT_KEEP':'0xff',
+	}
+
 	def __init__(self, dest, orig, t_id, stat, *argv):
 		super(self.__class__, self).__init__(dest, orig, t_id, self.__class__.cmde, stat, *argv)
 
@@ -988,6 +1007,25 @@ class rout_del(Frame):
 		super(self.__class__, self).__init__(dest, orig, t_id, self.__class__.cmde, stat, *argv)
 
 
+class rout_load(Frame):
+	"""
+	replace the whole routing table by a block of routes
+	each route is 3 bytes long : virtual address, routed address, routing mode (see rout_add)
+	the table is saved in eeprom and restored at start-up
+	argv #0-1 request : offset in memory of the first route (MSB first)
+	argv #2 request : number of routes
+	argv #3 request : memory type (see container)
+		- 0xee eeprom,
+		- 0xff flash,
+		- 0xaa ram,
+	argv #4 request : table version, if not null and equal to the current one, the table is not loaded
+	argv #5 response : result OK (1) or ko (0)
+	"""
+	cmde = 0x2d
+	def __init__(self, dest, orig, t_id, stat, *argv):
+		super(self.__class__, self).__init__(dest, orig, t_id, self.__class__.cmde, stat, *argv)
+
+
 class data_acc(Frame):
 	"""
 	acceleration data
@@ -1080,6 +1118,54 @@ class cpu(Frame):
 		super(self.__class__, self).__init__(dest, orig, t_id, self.__class__.cmde, stat, *argv)
 
 
+class dpt_stats(Frame):
+	"""
+	dispatcher statistics
+	(error response unless the dispatcher is built with DPT_ENABLE_STATS)
+	argv #0 value : counters set (| 0x80 to reset the set after reading)
+		- 0x00 : channel counters
+			- argv #1 value : channel
+			- argv #2 - #3 resp : MSB - LSB frames delivered
+			- argv #4 - #5 resp : MSB - LSB frames dropped (reception queue full)
+		- 0x01 : channel emission counters
+			- argv #1 value : channel
+			- argv #2 - #3 resp : MSB - LSB frames refused (emission queue full or no free frame)
+			- argv #4 resp : reception queue high-water mark
+			- argv #5 resp : emission queue high-water mark
+		- 0x02 : twi counters
+			- argv #2 - #3 resp : MSB - LSB errors (including time-outs)
+			- argv #4 - #5 resp : MSB - LSB no slave
+		- 0x03 : lost frames counters
+			- argv #2 - #3 resp : MSB - LSB twi time-outs
+			- argv #4 - #5 resp : MSB - LSB frames lost (malformed, no free frame, fifo full)
+		- 0x04 : dispatcher high-water marks
+			- argv #2 resp : in fifo
+			- argv #3 resp : out fifo
+			- argv #4 resp : frames pool
+		- 0x05 : retried destinations
+			- argv #1 value : index
+			- argv #2 resp : destination
+			- argv #4 - #5 resp : MSB - LSB retries
+		- 0x06 : duplicates
+			- argv #2 - #3 resp : MSB - LSB duplicated requests dropped
+	"""
+	cmde = 0x29
+
+	defines = { 
+		'FR_DPT_STATS_CHAN':'0x00',
+		'FR_DPT_STATS_TX':'0x01',
+		'FR_DPT_STATS_TWI':'0x02',
+		'FR_DPT_STATS_LOST':'0x03',
+		'FR_DPT_STATS_HWM':'0x04',
+		'FR_DPT_STATS_RETRY':'0x05',
+		'FR_DPT_STATS_DUP':'0x06',
+		'FR_DPT_STATS_RESET':'0x80',
+	}
+
+	def __init__(self, dest, orig, t_id, stat, *argv):
+		super(self.__class__, self).__init__(dest, orig, t_id, self.__class__.cmde, stat, *argv)
+
+
 class led_cmd(Frame):
 	"""
 	set/get led blink rate
@@ -1107,6 +1193,67 @@ class led_cmd(Frame):
 		super(self.__class__, self).__init__(dest, orig, t_id, self.__class__.cmde, stat, *argv)
 
 
+class dpt_shape(Frame):
+	"""
+	dispatcher channel bandwidth shaping (token bucket)
+	(error response unless the dispatcher is built with DPT_ENABLE_SHAPE)
+	argv #0 value : channel
+	argv #1 value :
+		- 0x00 : set (and reset the throttled frames counter)
+		- 0xff : get
+	argv #2 value / resp : token period [0.01; 2.55] s (0x00 : no limit)
+	argv #3 value / resp : bucket depth in frames
+	argv #4 - #5 resp : MSB - LSB frames throttled
+	"""
+	cmde = 0x2b
+
+	defines = { 
+		'FR_DPT_SHAPE_SET':'0x00',
+		'FR_DPT_SHAPE_GET':'0xff',
+	}
+
+	def __init__(self, dest, orig, t_id, stat, *argv):
+		super(self.__class__, self).__init__(dest, orig, t_id, self.__class__.cmde, stat, *argv)
+
+
+class dpt_group(Frame):
+	"""
+	dispatcher multicast groups membership
+	argv #0 value : group address [0x80; 0x87]
+	argv #1 value :
+		- 0x00 : leave
+		- 0x01 : join
+		- 0xff : get
+	argv #2 resp : joined groups bitfield (bit 0 for group 0x80)
+	"""
+	cmde = 0x2c
+
+	defines = { 
+		'FR_DPT_GROUP_LEAVE':'0x00',
+		'FR_DPT_GROUP_JOIN':'0x01',
+		'FR_DPT_GROUP_GET':'0xff',
+	}
+
+	def __init__(self, dest, orig, t_id, stat, *argv):
+		super(self.__class__, self).__init__(dest, orig, t_id, self.__class__.cmde, stat, *argv)
+
+
+class nat_credit(Frame):
+	"""
+	flow control credits of a NAT host link (serial or ethernet)
+	the host can send as many frames as it has credits, each frame using one.
+	the gateway sends it unsolicited to return the credits
+	of the host frames passed on the bus (the whole window at start-up).
+	a request from the host is answered by the gateway itself
+	with the credits currently available.
+	argv #0 value : number of returned credits (response : number of available credits)
+	argv #1 value : credits window size
+	"""
+	cmde = 0x2e
+	def __init__(self, dest, orig, t_id, stat, *argv):
+		super(self.__class__, self).__init__(dest, orig, t_id, self.__class__.cmde, stat, *argv)
+
+
 class appli_start(Frame):
 	"""
 	application start signal
@@ -1117,6 +1264,23 @@ class appli_start(Frame):
 		super(self.__class__, self).__init__(dest, orig, t_id, self.__class__.cmde, stat, *argv)
 
 
+# command filters of the modules
+# each one lists the frames (or raw command values) the module subscribes to
+# and is generated as a flash bitmap (FR_MASK_<MODULE>) covering the 256 commands
+filters = {
+	'ALL' : range(256),
+	'BSC' : (no_cmde, ram_read, ram_write, eep_read, eep_write, flh_read, flh_write, spi_read, spi_write, wait, container),
+	'CMN' : (state, time_get, mux_reset, led_cmd, dpt_stats, dpt_shape, dpt_group),
+	'DNA' : (dna_register, dna_list, dna_line, i2c_write, i2c_read),
+	'LOG' : (state, mux_reset, reconf_mode, take_off, switch_power, log_cmd),
+	'RCF' : (take_off, reconf_mode),
+	'ROUT' : (rout_list, rout_line, rout_add, rout_del, rout_load),
+}
+
+# size of a command filter in octets
+MASK_SIZE = 256 / 8
+
+
 def frame(dest=None, orig=None, stat=None, cmde=None, *argv):
 	"""
 	helper function to create a new frame
@@ -1158,6 +1322,19 @@ def frame_defines(h, doc):
 		h.write('\n')
 
 
+# compute the bitmap of a command filter
+def filter_bitmap(cmdes):
+	bitmap = [0] * MASK_SIZE
+
+	for c in cmdes:
+		# frame classes are replaced by their command value
+		if type(c) != int:
+			c = c.cmde
+		bitmap[c / 8] |= 1 << (c % 8)
+
+	return bitmap
+
+
 def generate_h(h):
 	h.write('#ifndef __FRAMES_H__\n')
 	h.write('# define __FRAMES_H__\n')
@@ -1180,6 +1357,9 @@ def generate_h(h):
 	h.write('# define FRAME_STAT_OFFSET\t4\n')
 	h.write('# define FRAME_ARGV_OFFSET\t5\n')
 	h.write('\n')
+	h.write('// command filters size in octets (1 bit per command)\n')
+	h.write('# define FR_MASK_SIZE\t%d\n' % MASK_SIZE)
+	h.write('\n')
 	# if some commands needs particular defines
 	for dc in Frame.get_derived_class().values():
 		# extract frame defines
@@ -1226,12 +1406,30 @@ def generate_h(h):
 		h.write(');\n')
 		h.write('\n')
 	h.write('\n')
+	h.write('// modules command filters (stored in flash)\n')
+	for m in sorted(filters.keys()):
+		h.write('extern const u8 FR_MASK_%s[FR_MASK_SIZE];\n' % m)
+	h.write('\n')
+	h.write('\n')
 	h.write('#endif\t// __FRAMES_H__\n')
 
 
 def generate_c(c):
 	c.write('#include "fr_cmdes.h"\n')
 	c.write('\n')
+	c.write('#include <avr/pgmspace.h>\n')
+	c.write('\n')
+	c.write('\n')
+	for m in sorted(filters.keys()):
+		c.write('const u8 FR_MASK_%s[FR_MASK_SIZE] PROGMEM = {' % m)
+		for i, b in enumerate(filter_bitmap(filters[m])):
+			if i % 8 == 0:
+				c.write('\n\t')
+			else:
+				c.write(' ')
+			c.write('0x%02x,' % b)
+		c.write('\n};\n')
+		c.write('\n')
 	c.write('\n')
 	for i in range(Frame.nb_args + 1):
 		c.write('u8 frame_set_%d(frame_t* fr, u8 dest, u8 orig, fr_cmdes_t cmde, u8 len' % i)
@@ -31,6 +31,7 @@
 #include "externals/sdcard.h"
 
 #include "avr/io.h"
+#include <avr/pgmspace.h>	// memcpy_P()
 
 #include <string.h>		// memset()
 
@@ -39,12 +40,16 @@
 // private defines
 //
 
-#define NB_FRAMES	7
 
-#define MINIMAL_FILTER	_CM(FR_LOG_CMD)
+#define NB_FILTER_BLOCKS	(FR_MASK_SIZE / 8)	// blocks of 64 commands in the filter
 
 #define NB_ORIG_FILTER	6
 
+// the log area follows the saved routing table
+#if ROUT_EEP_ADDR + ROUT_EEP_SIZE >= 1024
+# error "the saved routing table leaves no eeprom for the log area"
+#endif
+
 #define SAVE_IN_RAM_ENABLED
 #ifdef SAVE_IN_RAM_ENABLED
 #ifndef DEBUG_EXTRA
@@ -81,16 +86,18 @@ static struct {
 	pt_t	log_pt;				// context
 
 	fifo_t	in_fifo;			// reception fifo
-	frame_t in_buf[NB_FRAMES];
-	frame_t fr;				// command frame 
+	frame_t* in_buf[LOG_NB_IN];
+	frame_t* in;				// received frame (read in place)
 
 	log_state_t state;			// logging state
+	u8 is_saving;				// TRUE while a log block is being saved
 
 	u16	eeprom_addr;			// address in eeprom
 	u64	sdcard_addr;			// address in sdcard
 	u8	index;					// session index
 
 	u8 orig_filter[NB_ORIG_FILTER];	// origin node filter
+	u8 cmde_filter[FR_MASK_SIZE];		// command filter bitmap
 
 	log_t block;
 
@@ -199,7 +206,19 @@ static void LOG_find_sdcard_start(u8 eeprom_index)
 
 static void LOG_command(frame_t* fr)
 {
-	u64 filter;
+	u8* filter;
+	u8 i;
+
+	// the filter commands address a block of 64 commands
+	// split in a LSB and a MSB part of 32 commands
+	// an unknown block gives no filter
+	filter = NULL;
+	if ( fr->argv[5] < NB_FILTER_BLOCKS ) {
+		filter = &LOG.cmde_filter[fr->argv[5] * 8];
+		if ( (fr->argv[0] == FR_LOG_CMD_SET_MSB) || (fr->argv[0] == FR_LOG_CMD_GET_MSB) ) {
+			filter += 4;
+		}
+	}
 
 	// upon the sub-command
 	switch ( fr->argv[0] ) {
@@ -220,49 +239,29 @@ static void LOG_command(frame_t* fr)
 		break;
 
 	case FR_LOG_CMD_SET_LSB:	// set command filter LSB part
-		filter  = (u64)fr->argv[1] << 24;
-		filter &= (u64)fr->argv[2] << 16;
-		filter &= (u64)fr->argv[3] <<  8;
-		filter &= (u64)fr->argv[4] <<  0;
-
-		// preserve the logging basic communication
-		filter |= MINIMAL_FILTER;
-
-		// set the new filter value
-		LOG.interf.cmde_mask = filter;
-		break;
-
 	case FR_LOG_CMD_SET_MSB:	// set command filter MSB part
-		filter  = (u64)fr->argv[1] << 56;
-		filter &= (u64)fr->argv[2] << 48;
-		filter &= (u64)fr->argv[3] << 40;
-		filter &= (u64)fr->argv[4] << 32;
-
-		// preserve the logging basic communication
-		filter |= MINIMAL_FILTER;
+		if ( filter == NULL ) {
+			fr->error = 1;
+			break;
+		}
 
-		// set the new filter value
-		LOG.interf.cmde_mask = filter;
+		// set the new filter value (MSB first)
+		for ( i = 0; i < 4; i++ ) {
+			filter[i] = fr->argv[4 - i];
+		}
 		break;
 
 	case FR_LOG_CMD_GET_LSB:	// get command filter LSB part
-		// get the filter value
-		filter = LOG.interf.cmde_mask;
-
-		fr->argv[1] = (u8)(filter >> 24);
-		fr->argv[2] = (u8)(filter >> 16);
-		fr->argv[3] = (u8)(filter >>  8);
-		fr->argv[4] = (u8)(filter >>  0);
-		break;
-
 	case FR_LOG_CMD_GET_MSB:	// get command filter MSB part
-		// get the filter value
-		filter = LOG.interf.cmde_mask;
+		if ( filter == NULL ) {
+			fr->error = 1;
+			break;
+		}
 
-		fr->argv[1] = (u8)(filter >> 56);
-		fr->argv[2] = (u8)(filter >> 48);
-		fr->argv[3] = (u8)(filter >> 40);
-		fr->argv[4] = (u8)(filter >> 32);
+		// get the filter value (MSB first)
+		for ( i = 0; i < 4; i++ ) {
+			fr->argv[4 - i] = filter[i];
+		}
 		break;
 
 	case FR_LOG_CMD_SET_ORIG:	// set origin filter
@@ -284,6 +283,24 @@ static void LOG_command(frame_t* fr)
 }
 
 
+// check if the storage media of the logging state is full
+static u8 LOG_is_full(void)
+{
+	switch ( LOG.state ) {
+		case LOG_EEPROM:
+			// if address is out of range
+			return LOG.eeprom_addr >= EEPROM_END_ADDR;
+
+		case LOG_SDCARD:
+			// if address is out of range
+			return LOG.sdcard_addr >= SDCARD_END_ADDR;
+
+		default:
+			return FALSE;
+	}
+}
+
+
 static PT_THREAD( LOG_log(pt_t* pt) )
 {
 	u32 time;
@@ -301,7 +318,9 @@ static PT_THREAD( LOG_log(pt_t* pt) )
 		case LOG_OFF:
 		default:
 			// empty the log fifo
-			(void)FIFO_get(&LOG.in_fifo, &LOG.fr);
+			if ( FIFO_get(&LOG.in_fifo, &LOG.in) ) {
+				DPT_free(LOG.in);
+			}
 
 			// loop back for next frame
 			PT_RESTART(pt);
@@ -313,35 +332,25 @@ static PT_THREAD( LOG_log(pt_t* pt) )
 			break;
 
 		case LOG_EEPROM:
-			// if address is out of range
-			if ( LOG.eeprom_addr >= EEPROM_END_ADDR ) {
-				// logging is no more possible
-				// so quit
-				PT_EXIT(pt);
-			}
-			break;
-
 		case LOG_SDCARD:
-			// if address is out of range
-			if ( LOG.sdcard_addr >= SDCARD_END_ADDR ) {
-				// logging is no more possible
-				// so quit
-				PT_EXIT(pt);
-			}
 			break;
 	}
 
 	// wait while no frame is present in the fifo
-	PT_WAIT_WHILE(pt, KO == FIFO_get(&LOG.in_fifo, &LOG.fr));
+	// the frame is shared with the other receivers
+	// so it is read in place and released before any wait
+	PT_WAIT_WHILE(pt, KO == FIFO_get(&LOG.in_fifo, &LOG.in));
 
 	// if it is a log command
-	if ( (LOG.fr.cmde == FR_LOG_CMD) && (!LOG.fr.resp) ) {
-		// treat it
-		LOG_command(&LOG.fr);
+	if ( (LOG.in->cmde == FR_LOG_CMD) && (!LOG.in->resp) ) {
+		// treat it in the log block frame
+		LOG.block.fr = *LOG.in;
+		DPT_free(LOG.in);
+		LOG_command(&LOG.block.fr);
 
 		// send the response
 		DPT_lock(&LOG.interf);
-		PT_WAIT_UNTIL(pt, OK == DPT_tx(&LOG.interf, &LOG.fr));
+		PT_WAIT_UNTIL(pt, OK == DPT_tx(&LOG.interf, &LOG.block.fr));
 		DPT_unlock(&LOG.interf);
 
 
@@ -349,11 +358,27 @@ static PT_THREAD( LOG_log(pt_t* pt) )
 		PT_RESTART(pt);
 	}
 
+	// if the storage media is full
+	if ( LOG_is_full() ) {
+		// logging is no more possible
+		// but the frames are still drained
+		// so the log commands can select another media
+		DPT_free(LOG.in);
+		PT_RESTART(pt);
+	}
+
+	// if the command of the frame is filtered away
+	if ( !(LOG.cmde_filter[LOG.in->cmde >> 3] & (1 << (LOG.in->cmde & 0x07))) ) {
+		// lop back for next frame
+		DPT_free(LOG.in);
+		PT_RESTART(pt);
+	}
+
 	// filter the frame according to its origin
 	is_filtered = OK;	// by default, every frame is filtered
 	for ( i = 0; i < sizeof(LOG.orig_filter); i++ ) {
 		// passthrough or frame origin and filter acceptance match
-		if ( (LOG.orig_filter[i] == 0x00) || (LOG.orig_filter[i] == LOG.fr.orig) ){
+		if ( (LOG.orig_filter[i] == 0x00) || (LOG.orig_filter[i] == LOG.in->orig) ){
 			is_filtered = KO;
 			break;
 		}
@@ -362,6 +387,7 @@ static PT_THREAD( LOG_log(pt_t* pt) )
 	// if frame is filtered away
 	if ( is_filtered ) {
 		// lop back for next frame
+		DPT_free(LOG.in);
 		PT_RESTART(pt);
 	}
 
@@ -370,7 +396,11 @@ static PT_THREAD( LOG_log(pt_t* pt) )
 	time = TIME_get();
 	LOG.block.time[0] = (u8)(time >> 16);
 	LOG.block.time[1] = (u8)(time >>  8);
-	LOG.block.fr = LOG.fr;
+	LOG.block.fr = *LOG.in;
+	DPT_free(LOG.in);
+
+	// the storage media are polled until the saving is done
+	LOG.is_saving = TRUE;
 
 	switch ( LOG.state ) {
 		case LOG_OFF:
@@ -406,6 +436,8 @@ static PT_THREAD( LOG_log(pt_t* pt) )
 			break;
 	}
 
+	LOG.is_saving = FALSE;
+
 	// loop back to treat the next frame to log
 	PT_RESTART(pt);
 
@@ -424,12 +456,13 @@ void LOG_init(void)
 
 	// init context and fifo
 	PT_INIT(&LOG.log_pt);
-	FIFO_init(&LOG.in_fifo, &LOG.in_buf, NB_FRAMES, sizeof(LOG.in_buf[0]));
+	FIFO_init(&LOG.in_fifo, &LOG.in_buf, LOG_NB_IN, sizeof(LOG.in_buf[0]));
 
 	// reset scan start address and index
 	LOG.eeprom_addr = EEPROM_START_ADDR;
 	LOG.sdcard_addr = SDCARD_START_ADDR;
 	LOG.index = 0;
+	LOG.is_saving = FALSE;
 
 	// origin filter blocks every node by default
 	memset(&LOG.orig_filter, 0xff, NB_ORIG_FILTER);
@@ -445,20 +478,19 @@ void LOG_init(void)
 	index = LOG_find_eeprom_start();
 	LOG_find_sdcard_start(index);
 
-	// register to dispatcher
-	LOG.interf.channel = 6;
-	LOG.interf.queue = &LOG.in_fifo;
+	// the command filter is held in RAM to be modified by the log commands
 #if 0	// for debug
-	LOG.interf.cmde_mask = _CM(FR_STATE)
-				| _CM(FR_MUX_RESET)
-				| _CM(FR_RECONF_MODE)
-				| _CM(FR_MINUT_TAKE_OFF)
-				| _CM(FR_MINUT_DOOR)
-				| _CM(FR_SWITCH_POWER)
-				| MINIMAL_FILTER;
+	memcpy_P(LOG.cmde_filter, FR_MASK_LOG, FR_MASK_SIZE);
 #else
-	LOG.interf.cmde_mask = -1;
+	memcpy_P(LOG.cmde_filter, FR_MASK_ALL, FR_MASK_SIZE);
 #endif
+
+	// register to dispatcher
+	// every frame is received and filtered by the log thread
+	// so the log commands always get through
+	LOG.interf.channel = 6;
+	LOG.interf.queue = &LOG.in_fifo;
+	LOG.interf.cmde_mask = FR_MASK_ALL;
 	DPT_register(&LOG.interf);
 }
 
@@ -466,6 +498,11 @@ void LOG_init(void)
 // log run method
 void LOG_run(void)
 {
+	// nothing to do until a frame is received or while saving
+	if ( !DPT_ready(&LOG.interf) && !LOG.is_saving ) {
+		return;
+	}
+
 	// logging job
 	(void)PT_SCHEDULE(LOG_log(&LOG.log_pt));
 }
@@ -28,15 +28,23 @@
 
 # include "type_def.h"
 
+# include "routing_tables.h"	// ROUT_EEP_ADDR, ROUT_EEP_SIZE
+
 
 //--------------------------------------
 // configuration defines
 //
 
 // eeprom limits
-#define EEPROM_START_ADDR	((u16)256)		// the place before is reserved for event frames
+// the place before is reserved for event frames and the routing table
+#define EEPROM_START_ADDR	((u16)(ROUT_EEP_ADDR + ROUT_EEP_SIZE))
 #define EEPROM_END_ADDR		((u16)1024)		// 1 Ko
 
+// incoming frames buffer size
+#ifndef LOG_NB_IN
+# define LOG_NB_IN	4
+#endif
+
 // sdcard limits
 #define SDCARD_START_ADDR	((u64)0x100)	// FAT headers
 #define SDCARD_END_ADDR		((u64)2 * 1024 * 1024 * 1024)	// 2 Go
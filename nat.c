@@ -24,7 +24,9 @@
 #include "dispatcher.h"
 
 #ifdef NAT_ENABLE_RS
-#include "drivers/rs.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/crc16.h>		// _crc_ccitt_update()
 #endif
 
 #ifdef NAT_ENABLE_ETH
@@ -41,11 +43,73 @@
 // private defines
 //
 
-#define QUEUE_SIZE		1
+#ifndef NAT_HOST_OUT_SIZE
+# define NAT_HOST_OUT_SIZE	3		// frames to a host link
+#endif
+#ifndef NAT_HOST_CREDITS
+# define NAT_HOST_CREDITS	4		// frames a host link can send before waiting for credits
+#endif
+
+#if defined(NAT_ENABLE_RS) && defined(NAT_ENABLE_ETH)
+# define NAT_NB_HOSTS		2
+#else
+# define NAT_NB_HOSTS		1
+#endif
+
+// frames to the bus, enough for the credits of every host link
+#define NAT_TWI_OUT_SIZE	(NAT_NB_HOSTS * NAT_HOST_CREDITS)
+
+// returned credits are sent as soon as half the window is reached
+// or when the link has nothing else to send
+#define NAT_CREDIT_BATCH	((NAT_HOST_CREDITS + 1) / 2)
 
 #define NAT_ETH_CMDE_PORT	((u16)7777)
 #define NAT_ETH_CMDE_IP		((u32)0xc0a80701)		// 192.168.7.1
 
+#ifndef NAT_RS_BAUD
+# define NAT_RS_BAUD		115200	// serial link speed
+#endif
+#if defined(NAT_ENABLE_RS) && !defined(F_CPU)
+# error "F_CPU shall give the cpu frequency to set the serial link speed"
+#endif
+#ifndef NAT_RS_RX_SIZE
+# define NAT_RS_RX_SIZE		64		// serial reception ring size (power of 2)
+#endif
+#ifndef NAT_RS_TX_SIZE
+# define NAT_RS_TX_SIZE		64		// serial emission ring size (power of 2)
+#endif
+
+#if (NAT_RS_RX_SIZE & (NAT_RS_RX_SIZE - 1)) || (NAT_RS_RX_SIZE > 256) || (NAT_RS_TX_SIZE & (NAT_RS_TX_SIZE - 1)) || (NAT_RS_TX_SIZE > 256)
+# error "NAT_RS_RX_SIZE and NAT_RS_TX_SIZE shall be a power of 2 up to 256"
+#endif
+
+// serial frame : dest, orig, t_id, cmde, status, argv then crc (MSB first)
+#define NAT_RS_FRAME_LEN	(5 + FRAME_NB_ARGS)
+#define NAT_RS_RAW_LEN		(NAT_RS_FRAME_LEN + 2)
+
+// longest SLIP encoded frame : every octet escaped and surrounded by 2 END
+#define NAT_RS_SLIP_MAX		(2 * NAT_RS_RAW_LEN + 2)
+
+// SLIP special octets
+#define SLIP_END		0xc0
+#define SLIP_ESC		0xdb
+#define SLIP_ESC_END	0xdc
+#define SLIP_ESC_ESC	0xdd
+
+
+
+//----------------------------------------
+// private types
+//
+
+typedef struct {
+	u8 used;					// frames of the host link not yet sent on the bus
+	u8 credits;					// credits not yet returned to the host
+	u8 query;					// TRUE when the host requested its credits
+	u8 dest;					// credit request addresses and transaction
+	u8 orig;
+	u8 t_id;
+} nat_credit_t;
 
 
 //----------------------------------------
@@ -55,38 +119,48 @@
 static struct {
 	pt_t twi_in_pt;				// twi in part
 	fifo_t twi_in_fifo;
-	frame_t twi_in_buf[QUEUE_SIZE];
+	frame_t* twi_in_buf[NAT_TWI_IN_SIZE];
 	dpt_interface_t interf;		// dispatcher interface
 	frame_t twi_in;	
 
 	pt_t twi_out_pt;			// twi out part
 	fifo_t twi_out_fifo;
-	frame_t twi_out_buf[QUEUE_SIZE];
+	frame_t twi_out_buf[NAT_TWI_OUT_SIZE];
 	frame_t twi_out;
 
 #ifdef NAT_ENABLE_ETH
 	pt_t eth_in_pt;				// eth in part
-	fifo_t eth_in_fifo;
-	frame_t eth_in_buf[QUEUE_SIZE];
 	frame_t eth_in;
 
 	pt_t eth_out_pt;			// eth out part
 	fifo_t eth_out_fifo;
-	frame_t eth_out_buf[QUEUE_SIZE];
+	frame_t eth_out_buf[NAT_HOST_OUT_SIZE];
 	frame_t eth_out;
+
+	nat_credit_t eth_credit;	// eth flow control
 #endif
 
 #ifdef NAT_ENABLE_RS
 	pt_t rs_in_pt;				// rx in part
-	u32 time_out;				// time-out in reception
-	fifo_t rs_in_fifo;
-	frame_t rs_in_buf[QUEUE_SIZE];
 	frame_t rs_in;
+	u8 rs_raw[NAT_RS_RAW_LEN];	// decoded octets of the current frame
+	u8 rs_len;					// number of decoded octets
+	u8 rs_esc;					// TRUE after an escape octet
 
 	pt_t rs_out_pt;
 	fifo_t rs_out_fifo;
-	frame_t rs_out_buf[QUEUE_SIZE];
+	frame_t rs_out_buf[NAT_HOST_OUT_SIZE];
 	frame_t rs_out;
+
+	nat_credit_t rs_credit;		// rs flow control
+
+	// interrupt driven rings
+	u8 rx_buf[NAT_RS_RX_SIZE];
+	volatile u8 rx_head;		// written by the reception interrupt
+	volatile u8 rx_tail;
+	u8 tx_buf[NAT_RS_TX_SIZE];
+	volatile u8 tx_head;
+	volatile u8 tx_tail;		// written by the emission interrupt
 #endif
 } NAT;
 
@@ -95,8 +169,107 @@ static struct {
 // private functions
 //
 
+#if defined(NAT_ENABLE_RS) || defined(NAT_ENABLE_ETH)
 //----------------------------------------
-// eth part
+// host links flow control
+//
+
+// reset the flow control of a host link
+// the whole window is returned to the host
+static void NAT_credit_init(nat_credit_t* cr)
+{
+	cr->used = 0;
+	cr->credits = NAT_HOST_CREDITS;
+	cr->query = FALSE;
+}
+
+
+// check a frame from a host link
+// return OK if it is a credit request to be answered by the gateway
+static u8 NAT_credit_in(nat_credit_t* cr, frame_t* fr)
+{
+	if ( fr->cmde == FR_NAT_CREDIT ) {
+		cr->query = TRUE;
+		cr->dest = fr->dest;
+		cr->orig = fr->orig;
+		cr->t_id = fr->t_id;
+
+		return OK;
+	}
+
+	// the frame uses a credit until it is sent on the bus
+	cr->used++;
+
+	return KO;
+}
+
+
+// a frame of a host link is sent on the bus, its credit is to be returned
+static void NAT_credit_back(nat_credit_t* cr)
+{
+	if ( cr->used ) {
+		cr->used--;
+		cr->credits++;
+	}
+}
+
+
+// build a credit frame
+static void NAT_credit_frame(frame_t* fr, u8 nb)
+{
+	memset(fr, 0, sizeof(frame_t));
+	fr->cmde = FR_NAT_CREDIT;
+	fr->argv[0] = nb;
+	fr->argv[1] = NAT_HOST_CREDITS;
+	fr->len = 2;
+}
+
+
+// retrieve the next frame to send on a host link
+static u8 NAT_host_out(nat_credit_t* cr, fifo_t* fifo, frame_t* fr)
+{
+	// the answer to a credit request comes first
+	// the returned credits are included
+	if ( cr->query ) {
+		NAT_credit_frame(fr, NAT_HOST_CREDITS - cr->used);
+		fr->dest = cr->orig;
+		fr->orig = cr->dest;
+		fr->t_id = cr->t_id;
+		fr->resp = 1;
+		cr->query = FALSE;
+		cr->credits = 0;
+
+		return OK;
+	}
+
+	// then enough credits to be returned
+	if ( cr->credits >= NAT_CREDIT_BATCH ) {
+		NAT_credit_frame(fr, cr->credits);
+		cr->credits = 0;
+
+		return OK;
+	}
+
+	// then the frames from the bus
+	if ( FIFO_get(fifo, fr) ) {
+		return OK;
+	}
+
+	// and the remaining credits when the link is idle
+	if ( cr->credits ) {
+		NAT_credit_frame(fr, cr->credits);
+		cr->credits = 0;
+
+		return OK;
+	}
+
+	return KO;
+}
+#endif
+
+
+//----------------------------------------
+// twi part
 //
 
 static PT_THREAD( NAT_twi_in(pt_t* pt) )
@@ -104,7 +277,7 @@ static PT_THREAD( NAT_twi_in(pt_t* pt) )
 	PT_BEGIN(pt);
 
 	// wait for a frame
-	PT_WAIT_UNTIL(pt, FIFO_get(&NAT.twi_in_fifo, &NAT.twi_in));
+	PT_WAIT_UNTIL(pt, DPT_rx(&NAT.interf, &NAT.twi_in));
 	DPT_unlock(&NAT.interf);
 
 #ifdef NAT_ENABLE_ETH
@@ -151,6 +324,18 @@ static PT_THREAD( NAT_twi_out(pt_t* pt) )
 	PT_WAIT_UNTIL(pt, DPT_tx(&NAT.interf, &NAT.twi_out));
 	DPT_unlock(&NAT.interf);
 
+	// the host link can send one more frame
+#ifdef NAT_ENABLE_ETH
+	if ( NAT.twi_out.eth ) {
+		NAT_credit_back(&NAT.eth_credit);
+	}
+#endif
+#ifdef NAT_ENABLE_RS
+	if ( NAT.twi_out.serial ) {
+		NAT_credit_back(&NAT.rs_credit);
+	}
+#endif
+
 	// loop back for processing next frame
 	PT_RESTART(pt);
 
@@ -170,6 +355,11 @@ static PT_THREAD( NAT_eth_in(pt_t* pt) )
 	// check if an ethernet command frame has arrived
 	PT_WAIT_UNTIL(pt, W5100_rx(NAT_ETH_CMDE_PORT, (u8*)&NAT.eth_in, sizeof(NAT.eth_in)));
 
+	// a credit request is answered by the gateway
+	if ( OK == NAT_credit_in(&NAT.eth_credit, &NAT.eth_in) ) {
+		PT_RESTART(pt);
+	}
+
 	// force eth bit
 	NAT.eth_in.eth = 1;
 
@@ -187,8 +377,8 @@ static PT_THREAD( NAT_eth_out(pt_t* pt) )
 {
 	PT_BEGIN(pt);
 
-	// wait for a frame
-	PT_WAIT_UNTIL(pt, FIFO_get(&NAT.eth_out_fifo, &NAT.eth_out));
+	// wait for a frame or credits to return
+	PT_WAIT_UNTIL(pt, NAT_host_out(&NAT.eth_credit, &NAT.eth_out_fifo, &NAT.eth_out));
 
 	// send the frame via the eth link
 	PT_WAIT_UNTIL(pt, W5100_tx(NAT_ETH_CMDE_IP, NAT_ETH_CMDE_PORT, (u8*)&NAT.eth_out, sizeof(NAT.eth_out)));
@@ -206,88 +396,198 @@ static PT_THREAD( NAT_eth_out(pt_t* pt) )
 // rs part
 //
 
-static PT_THREAD( NAT_rs_in(pt_t* pt) )
+#ifdef NAT_ENABLE_RS_ISR
+ISR(USART_RX_vect)
 {
-	int c = EOF;
+	NAT_rs_rx(UDR0);
+}
 
-	PT_BEGIN(pt);
 
-	// read tty command
-	// first char (dest) can be awaited infinitively
-	PT_WAIT_WHILE(pt, EOF == (c = getchar()) );
-	NAT.rs_in.dest = (u8)(c & 0xff);
-
-	// following char (orig) is subject of time-out
-	NAT.time_out = TIME_get() + 5 * TIME_1_MSEC;
-	PT_WAIT_WHILE(pt, (TIME_get() < NAT.time_out) && (EOF == (c = getchar())) );
-	NAT.rs_in.orig = (u8)(c & 0xff);
-
-	// next char (t_id) is also subject of time-out
-	NAT.time_out += 5 * TIME_1_MSEC;
-	PT_WAIT_WHILE(pt, (TIME_get() < NAT.time_out) && (EOF == (c = getchar())) );
-	NAT.rs_in.t_id = (u8)(c & 0xff);
-
-	// next char (cmde) is also subject of time-out
-	NAT.time_out += 5 * TIME_1_MSEC;
-	PT_WAIT_WHILE(pt, (TIME_get() < NAT.time_out) && (EOF == (c = getchar())) );
-	NAT.rs_in.cmde = (u8)(c & 0xff);
-
-	// next char (status) is also subject of time-out
-	NAT.time_out += 5 * TIME_1_MSEC;
-	PT_WAIT_WHILE(pt, (TIME_get() < NAT.time_out) && (EOF == (c = getchar())) );
-	NAT.rs_in.resp = (c & 0x80) ? 1 : 0;
-	NAT.rs_in.error = (c & 0x40) ? 1 : 0;
-	NAT.rs_in.time_out = (c & 0x20) ? 1 : 0;
-	NAT.rs_in.serial = 1;	// force serial bit
-	NAT.rs_in.eth = 0;	// force serial bit
-
-	// next char (argv #0) is also subject of time-out
-	NAT.time_out += 5 * TIME_1_MSEC;
-	PT_WAIT_WHILE(pt, (TIME_get() < NAT.time_out) && (EOF == (c = getchar())) );
-	NAT.rs_in.argv[0] = (u8)(c & 0xff);
-
-	// next char (argv #1) is also subject of time-out
-	NAT.time_out += 5 * TIME_1_MSEC;
-	PT_WAIT_WHILE(pt, (TIME_get() < NAT.time_out) && (EOF == (c = getchar())) );
-	NAT.rs_in.argv[1] = (u8)(c & 0xff);
-
-	// next char (argv #2) is also subject of time-out
-	NAT.time_out += 5 * TIME_1_MSEC;
-	PT_WAIT_WHILE(pt, (TIME_get() < NAT.time_out) && (EOF == (c = getchar())) );
-	NAT.rs_in.argv[2] = (u8)(c & 0xff);
-
-	// next char (argv #3) is also subject of time-out
-	NAT.time_out += 5 * TIME_1_MSEC;
-	PT_WAIT_WHILE(pt, (TIME_get() < NAT.time_out) && (EOF == (c = getchar())) );
-	NAT.rs_in.argv[3] = (u8)(c & 0xff);
-
-	// next char (argv #4) is also subject of time-out
-	NAT.time_out += 5 * TIME_1_MSEC;
-	PT_WAIT_WHILE(pt, (TIME_get() < NAT.time_out) && (EOF == (c = getchar())) );
-	NAT.rs_in.argv[4] = (u8)(c & 0xff);
-
-	// next char (argv #5) is also subject of time-out
-	NAT.time_out += 5 * TIME_1_MSEC;
-	PT_WAIT_WHILE(pt, (TIME_get() < NAT.time_out) && (EOF == (c = getchar())) );
-	NAT.rs_in.argv[5] = (u8)(c & 0xff);
-
-#if FRAME_NB_ARGS > 6
-	// next char (argv #6) is also subject of time-out
-	NAT.time_out += 5 * TIME_1_MSEC;
-	PT_WAIT_WHILE(pt, (TIME_get() < NAT.time_out) && (EOF == (c = getchar())) );
-	NAT.rs_in.argv[6] = (u8)(c & 0xff);
+ISR(USART_UDRE_vect)
+{
+	NAT_rs_udre();
+}
 #endif
 
-	// if a time-out happens
-	if ( TIME_get() >= NAT.time_out ) {
-		// loop back
-		PT_RESTART(pt);
+
+// reception interrupt : store the octet in the ring
+void NAT_rs_rx(u8 c)
+{
+	u8 next = (NAT.rx_head + 1) & (NAT_RS_RX_SIZE - 1);
+
+	// if the ring is full, the octet is lost
+	// and the frame will be rejected by its crc
+	if ( next != NAT.rx_tail ) {
+		NAT.rx_buf[NAT.rx_head] = c;
+		NAT.rx_head = next;
 	}
+}
 
-	// enqueue the frame to send it via the twi link
-	PT_WAIT_WHILE(pt, KO == FIFO_put(&NAT.twi_out_fifo, &NAT.rs_in));
 
-	// loop back for processing next frame
+// emission interrupt : send the next octet of the ring
+void NAT_rs_udre(void)
+{
+	if ( NAT.tx_tail != NAT.tx_head ) {
+		UDR0 = NAT.tx_buf[NAT.tx_tail];
+		NAT.tx_tail = (NAT.tx_tail + 1) & (NAT_RS_TX_SIZE - 1);
+	}
+	else {
+		// nothing more to send
+		UCSR0B &= ~_BV(UDRIE0);
+	}
+}
+
+
+// retrieve a received octet
+static u8 NAT_rs_getc(u8* c)
+{
+	if ( NAT.rx_tail == NAT.rx_head ) {
+		return KO;
+	}
+
+	*c = NAT.rx_buf[NAT.rx_tail];
+	NAT.rx_tail = (NAT.rx_tail + 1) & (NAT_RS_RX_SIZE - 1);
+
+	return OK;
+}
+
+
+// number of free octets in the emission ring
+static u8 NAT_rs_room(void)
+{
+	return (NAT.tx_tail - NAT.tx_head - 1) & (NAT_RS_TX_SIZE - 1);
+}
+
+
+// store an octet in the emission ring
+static void NAT_rs_putc(u8 c)
+{
+	NAT.tx_buf[NAT.tx_head] = c;
+	NAT.tx_head = (NAT.tx_head + 1) & (NAT_RS_TX_SIZE - 1);
+}
+
+
+// store an octet in the emission ring with SLIP escaping
+static void NAT_rs_put_esc(u8 c)
+{
+	switch ( c ) {
+	case SLIP_END:
+		NAT_rs_putc(SLIP_ESC);
+		NAT_rs_putc(SLIP_ESC_END);
+		break;
+
+	case SLIP_ESC:
+		NAT_rs_putc(SLIP_ESC);
+		NAT_rs_putc(SLIP_ESC_ESC);
+		break;
+
+	default:
+		NAT_rs_putc(c);
+		break;
+	}
+}
+
+
+// compute the crc of the serial frame octets
+static u16 NAT_rs_crc(const u8* raw, u8 len)
+{
+	u16 crc = 0xffff;
+	u8 i;
+
+	for ( i = 0; i < len; i++ ) {
+		crc = _crc_ccitt_update(crc, raw[i]);
+	}
+
+	return crc;
+}
+
+
+// decode a received octet
+// return OK when a valid frame is available in NAT.rs_in
+static u8 NAT_rs_decode(u8 c)
+{
+	u16 crc;
+	u8 i;
+
+	switch ( c ) {
+	case SLIP_END:
+		// an END closes the current frame
+		i = NAT.rs_len;
+		NAT.rs_len = 0;
+		NAT.rs_esc = FALSE;
+
+		// a frame with a bad length or crc is dropped
+		if ( i != NAT_RS_RAW_LEN ) {
+			return KO;
+		}
+		crc = NAT_rs_crc(NAT.rs_raw, NAT_RS_FRAME_LEN);
+		if ( (NAT.rs_raw[NAT_RS_FRAME_LEN] != (crc >> 8)) || (NAT.rs_raw[NAT_RS_FRAME_LEN + 1] != (crc & 0xff)) ) {
+			return KO;
+		}
+
+		// extract the frame
+		NAT.rs_in.dest = NAT.rs_raw[0];
+		NAT.rs_in.orig = NAT.rs_raw[1];
+		NAT.rs_in.t_id = NAT.rs_raw[2];
+		NAT.rs_in.cmde = NAT.rs_raw[3];
+		NAT.rs_in.resp = (NAT.rs_raw[4] & 0x80) ? 1 : 0;
+		NAT.rs_in.error = (NAT.rs_raw[4] & 0x40) ? 1 : 0;
+		NAT.rs_in.time_out = (NAT.rs_raw[4] & 0x20) ? 1 : 0;
+		NAT.rs_in.serial = 1;	// force serial bit
+		NAT.rs_in.eth = 0;	// force serial bit
+		for ( i = 0; i < FRAME_NB_ARGS; i++ ) {
+			NAT.rs_in.argv[i] = NAT.rs_raw[5 + i];
+		}
+
+		return OK;
+
+	case SLIP_ESC:
+		NAT.rs_esc = TRUE;
+		return KO;
+
+	default:
+		// restore the escaped octet
+		if ( NAT.rs_esc ) {
+			NAT.rs_esc = FALSE;
+			if ( c == SLIP_ESC_END ) {
+				c = SLIP_END;
+			}
+			else if ( c == SLIP_ESC_ESC ) {
+				c = SLIP_ESC;
+			}
+		}
+
+		// a too long frame is dropped at its END
+		if ( NAT.rs_len < NAT_RS_RAW_LEN ) {
+			NAT.rs_raw[NAT.rs_len] = c;
+		}
+		if ( NAT.rs_len <= NAT_RS_RAW_LEN ) {
+			NAT.rs_len++;
+		}
+		return KO;
+	}
+}
+
+
+static PT_THREAD( NAT_rs_in(pt_t* pt) )
+{
+	u8 c;
+
+	PT_BEGIN(pt);
+
+	// wait for received octets
+	PT_WAIT_UNTIL(pt, NAT.rx_tail != NAT.rx_head);
+
+	// decode all of them, the whole burst of frames is handled at once
+	while ( OK == NAT_rs_getc(&c) ) {
+		// if a frame is complete and not a credit request
+		if ( (OK == NAT_rs_decode(c)) && (KO == NAT_credit_in(&NAT.rs_credit, &NAT.rs_in)) ) {
+			// enqueue the frame to send it via the twi link
+			PT_WAIT_UNTIL(pt, FIFO_put(&NAT.twi_out_fifo, &NAT.rs_in));
+		}
+	}
+
+	// loop back for processing next octets
 	PT_RESTART(pt);
 
 	PT_END(pt);
@@ -296,28 +596,43 @@ static PT_THREAD( NAT_rs_in(pt_t* pt) )
 
 static PT_THREAD( NAT_rs_out(pt_t* pt) )
 {
+	u8 raw[NAT_RS_RAW_LEN];
+	u16 crc;
+	u8 i;
+
 	PT_BEGIN(pt);
 
-	PT_WAIT_UNTIL(pt, FIFO_get(&NAT.rs_out_fifo, &NAT.rs_out));
+	// wait for a frame or credits to return
+	PT_WAIT_UNTIL(pt, NAT_host_out(&NAT.rs_credit, &NAT.rs_out_fifo, &NAT.rs_out));
 
 	// prepare received frame by suppressing serial bit
 	NAT.rs_out.serial = 0;
 
-	// enqueue the response
-	putchar(NAT.rs_out.dest);
-	putchar(NAT.rs_out.orig);
-	putchar(NAT.rs_out.t_id);
-	putchar(NAT.rs_out.cmde);
-	putchar( (NAT.rs_out.error << 7) | (NAT.rs_out.resp << 6) | (NAT.rs_out.time_out << 5) | (NAT.rs_out.eth << 4) | (NAT.rs_out.serial << 3) | (NAT.rs_out.len << 0) );
-	putchar(NAT.rs_out.argv[0]);
-	putchar(NAT.rs_out.argv[1]);
-	putchar(NAT.rs_out.argv[2]);
-	putchar(NAT.rs_out.argv[3]);
-	putchar(NAT.rs_out.argv[4]);
-	putchar(NAT.rs_out.argv[5]);
-#if FRAME_NB_ARGS > 6
-	putchar(NAT.rs_out.argv[6]);
-#endif
+	// wait until the encoded frame fits in the emission ring
+	PT_WAIT_UNTIL(pt, NAT_rs_room() >= NAT_RS_SLIP_MAX);
+
+	// build the serial frame
+	raw[0] = NAT.rs_out.dest;
+	raw[1] = NAT.rs_out.orig;
+	raw[2] = NAT.rs_out.t_id;
+	raw[3] = NAT.rs_out.cmde;
+	raw[4] = (NAT.rs_out.error << 7) | (NAT.rs_out.resp << 6) | (NAT.rs_out.time_out << 5) | (NAT.rs_out.eth << 4) | (NAT.rs_out.serial << 3) | (NAT.rs_out.len << 0);
+	for ( i = 0; i < FRAME_NB_ARGS; i++ ) {
+		raw[5 + i] = NAT.rs_out.argv[i];
+	}
+	crc = NAT_rs_crc(raw, NAT_RS_FRAME_LEN);
+	raw[NAT_RS_FRAME_LEN] = crc >> 8;
+	raw[NAT_RS_FRAME_LEN + 1] = crc & 0xff;
+
+	// enqueue it SLIP encoded, the leading END flushes any line noise
+	NAT_rs_putc(SLIP_END);
+	for ( i = 0; i < NAT_RS_RAW_LEN; i++ ) {
+		NAT_rs_put_esc(raw[i]);
+	}
+	NAT_rs_putc(SLIP_END);
+
+	// and start the emission
+	UCSR0B |= _BV(UDRIE0);
 
 	// loop back for processing next frame
 	PT_RESTART(pt);
@@ -336,34 +651,46 @@ void NAT_init(void)
 {
 	// init twi part
 	PT_INIT(&NAT.twi_in_pt);
-	FIFO_init(&NAT.twi_in_fifo, &NAT.twi_in_buf, QUEUE_SIZE, sizeof(NAT.twi_in_buf[0]));
+	FIFO_init(&NAT.twi_in_fifo, &NAT.twi_in_buf, NAT_TWI_IN_SIZE, sizeof(NAT.twi_in_buf[0]));
 	NAT.interf.channel = 5;
-	NAT.interf.cmde_mask = -1;	// accept all commands
+	NAT.interf.cmde_mask = FR_MASK_ALL;	// accept all commands
 	NAT.interf.queue = &NAT.twi_in_fifo;
 	DPT_register(&NAT.interf);
 
 	PT_INIT(&NAT.twi_out_pt);
-	FIFO_init(&NAT.twi_out_fifo, &NAT.twi_out_buf, QUEUE_SIZE, sizeof(NAT.twi_out_buf[0]));
+	FIFO_init(&NAT.twi_out_fifo, &NAT.twi_out_buf, NAT_TWI_OUT_SIZE, sizeof(NAT.twi_out_buf[0]));
 
 #ifdef NAT_ENABLE_ETH
 	// init eth part
 	PT_INIT(&NAT.eth_in_pt);
-	FIFO_init(&NAT.eth_in_fifo, &NAT.eth_in_buf, QUEUE_SIZE, sizeof(NAT.eth_in_buf[0]));
 	W5100_init();
 
 	PT_INIT(&NAT.eth_out_pt);
-	FIFO_init(&NAT.eth_out_fifo, &NAT.eth_out_buf, QUEUE_SIZE, sizeof(NAT.eth_out_buf[0]));
+	FIFO_init(&NAT.eth_out_fifo, &NAT.eth_out_buf, NAT_HOST_OUT_SIZE, sizeof(NAT.eth_out_buf[0]));
+	NAT_credit_init(&NAT.eth_credit);
 #endif
 
 #ifdef NAT_ENABLE_RS
 	// init serial part
 	PT_INIT(&NAT.rs_in_pt);
-	FIFO_init(&NAT.rs_in_fifo, &NAT.rs_in_buf, QUEUE_SIZE, sizeof(NAT.rs_in_buf[0]));
-	NAT.time_out = 0;
-	RS_init(B115200);
+	NAT.rs_len = 0;
+	NAT.rs_esc = FALSE;
+	NAT.rx_head = 0;
+	NAT.rx_tail = 0;
+	NAT.tx_head = 0;
+	NAT.tx_tail = 0;
+
+	// double speed, 8 bits, no parity, 1 stop bit
+	// with reception and emission interrupts
+	UBRR0H = ((F_CPU / 8 / NAT_RS_BAUD - 1) >> 8) & 0xff;
+	UBRR0L = ((F_CPU / 8 / NAT_RS_BAUD - 1) >> 0) & 0xff;
+	UCSR0A = _BV(U2X0);
+	UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+	UCSR0B = _BV(RXCIE0) | _BV(RXEN0) | _BV(TXEN0);
 
 	PT_INIT(&NAT.rs_out_pt);
-	FIFO_init(&NAT.rs_out_fifo, &NAT.rs_out_buf, QUEUE_SIZE, sizeof(NAT.rs_out_buf[0]));
+	FIFO_init(&NAT.rs_out_fifo, &NAT.rs_out_buf, NAT_HOST_OUT_SIZE, sizeof(NAT.rs_out_buf[0]));
+	NAT_credit_init(&NAT.rs_credit);
 #endif
 }
 
@@ -35,6 +35,18 @@
 //                                     | <--> twi [Node X]
 //                                     | <--> twi [Node Y]
 // [PC] eth <--> eth [Node Z] twi <--> | 
+//
+// on the serial link, each frame is sent as :
+//  dest, orig, t_id, cmde, status, argv, crc16 (CCITT, MSB first)
+// SLIP encoded (RFC 1055) with an END octet before and after it,
+// so the receiver resynchronizes on the next END after any lost octet.
+// a frame with a bad length or crc is dropped.
+//
+// each host link (serial or ethernet) has a window of credits.
+// the host can send as many frames as it has credits,
+// each one being returned by a FR_NAT_CREDIT frame once the frame is sent on the bus.
+// the whole window is given at start-up
+// and a FR_NAT_CREDIT request gives the credits currently available.
 
 
 #ifndef __NAT_H__
@@ -52,6 +64,15 @@
 //#define NAT_FORCE_RS
 //#define NAT_ENABLE_ETH
 
+// the serial link owns the USART interrupt vectors
+// else the application handling them (e.g. with the rs driver)
+// shall call NAT_rs_rx() and NAT_rs_udre()
+//#define NAT_ENABLE_RS_ISR
+
+# ifndef NAT_TWI_IN_SIZE
+#  define NAT_TWI_IN_SIZE	3		// frames from the bus
+# endif
+
 //----------------------------------------
 // public types
 //
@@ -67,4 +88,16 @@ extern void NAT_init(void);
 // NAT run method
 extern void NAT_run(void);
 
+
+# ifdef NAT_ENABLE_RS
+// serial link octet reception
+// to be called by the USART reception interrupt
+extern void NAT_rs_rx(u8 c);
+
+
+// serial link emission
+// to be called by the USART data register empty interrupt
+extern void NAT_rs_udre(void);
+# endif
+
 #endif	// __NAT_H__
@@ -73,7 +73,7 @@ static struct {
 	pt_t in_pt;					// in thread
 	frame_t in;
 	fifo_t in_fifo;
-	frame_t in_buf[QUEUE_SIZE];
+	frame_t* in_buf[QUEUE_SIZE];
 	dpt_interface_t interf;
 
 	pt_t out_pt;				// out thread
@@ -190,7 +190,7 @@ static PT_THREAD( RCF_in(pt_t* pt) )
 
 	PT_BEGIN(pt);
 
-	PT_WAIT_UNTIL(pt, FIFO_get(&RCF.in_fifo, &RCF.in));
+	PT_WAIT_UNTIL(pt, DPT_rx(&RCF.interf, &RCF.in));
 
 	// when receiving a take-off negative response
 	// if the bus state is NONE
@@ -269,7 +269,7 @@ void RCF_init(void)
 	PT_INIT(&RCF.in_pt);
 	FIFO_init(&RCF.in_fifo, &RCF.in_buf, QUEUE_SIZE, sizeof(RCF.in_buf[0]));
 	RCF.interf.channel = 1;
-	RCF.interf.cmde_mask = _CM(FR_MINUT_TAKE_OFF) | _CM(FR_RECONF_MODE);
+	RCF.interf.cmde_mask = FR_MASK_RCF;
 	RCF.interf.queue = &RCF.in_fifo;
 	DPT_register(&RCF.interf);
 
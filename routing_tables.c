@@ -25,12 +25,33 @@
 
 #include "utils/pt.h"
 #include "utils/fifo.h"
+#include "utils/time.h"
+
+#include "drivers/eeprom.h"
+
+#include <avr/pgmspace.h>	// memcpy_P()
+#include <string.h>		// memmove(), memset()
 
 //------------------------------------------
 // defines
 //
 
-#define ROUT_NB_RX		3
+#define ROUT_NB_LATENCY		8		// physical addresses with a measured latency
+
+#define ROUT_PROBE_PERIOD	TIME_1_SEC				// time between 2 probes of the dead addresses
+
+// probe response time-out
+// on a busy bus, the failed response only comes once the dispatcher retries are over
+#define ROUT_PROBE_TIME_OUT	((DPT_RETRY_TIME + 100) * TIME_1_MSEC)
+
+#if ROUT_NB_PAIRS > 255 || ROUT_NB_FLAT > 255
+# error "ROUT_NB_PAIRS and ROUT_NB_FLAT can't exceed 255 pairs"
+#endif
+
+// the saved table : header (3 bytes), routing modes (3 bytes each) and pairs (2 bytes each)
+#if 3 + ROUT_NB_ANYCAST * 3 + ROUT_NB_PAIRS * 2 > ROUT_EEP_SIZE
+# error "ROUT_EEP_SIZE is too small to save ROUT_NB_PAIRS pairs"
+#endif
 
 
 //------------------------------------------
@@ -42,6 +63,46 @@ typedef struct {
 	u8 routed_addr;
 } rout_elem_t;
 
+typedef struct {
+	u8 virtual_addr;
+	u8 mode;		// routing mode (FR_ROUT_ALL when free)
+	u8 next;		// next routed address for round-robin
+} rout_any_t;
+
+typedef struct {
+	u8 addr;		// physical address (0 when free)
+	u16 latency;	// smoothed response latency
+} rout_lat_t;
+
+typedef struct {
+	u8 virtual_addr;
+	u8 routed_addr;
+	u8 mode;		// virtual address routing mode
+} rout_entry_t;
+
+typedef struct {
+	u8 version;		// table version (0 if unknown)
+	u8 nb_pairs;
+	u8 sum;			// checksum of the version, the pairs and the routing modes
+} rout_eep_t;
+
+
+//------------------------------------------
+// private macros
+//
+
+// sorting key of a pair
+#define ROUT_KEY(virtual_addr, routed_addr)	( ((u16)(virtual_addr) << 8) | (routed_addr) )
+
+// addresses bitfield handling
+#define ROUT_MARK(marks, addr)		(marks)[(addr) >> 3] |= 1 << ((addr) & 0x07)
+#define ROUT_IS_MARKED(marks, addr)	((marks)[(addr) >> 3] & (1 << ((addr) & 0x07)))
+
+// saved table layout in eeprom : header, routing modes then pairs
+#define ROUT_EEP_HEADER		(ROUT_EEP_ADDR)
+#define ROUT_EEP_ANY		(ROUT_EEP_HEADER + sizeof(rout_eep_t))
+#define ROUT_EEP_PAIRS		(ROUT_EEP_ANY + ROUT_NB_ANYCAST * sizeof(rout_any_t))
+
 
 //------------------------------------------
 // private variables
@@ -50,13 +111,41 @@ typedef struct {
 static struct {
 	// routing table
 	u8 nb_pairs;
-	rout_elem_t table[MAX_ROUTES];
+	rout_elem_t table[ROUT_NB_PAIRS];
+
+	// expanded routes table
+	u8 nb_flat;
+	rout_elem_t flat[ROUT_NB_FLAT];
+
+	// virtual addresses routing modes
+	rout_any_t any[ROUT_NB_ANYCAST];
+
+	// physical addresses response latencies
+	rout_lat_t lat[ROUT_NB_LATENCY];
+	u8 lat_idx;					// next entry to replace
+
+	// physical addresses health
+	u8 dead[(DPT_LAST_ADDR + 1) / 8];	// not responding addresses bitfield
+	u8 nb_dead;					// number of dead addresses
+	u8 probe_addr;				// last probed address
+	u32 probe_time;				// next probe time
+	u8 call;					// probe call
+	frame_t probe;				// probe frame
+	pt_t probe_pt;				// probe thread context
+
+	// saved table
+	rout_eep_t eep;				// header of the saved table
+	u8 is_modified;				// TRUE when the table is to be saved
+	u8 is_eep_busy;				// TRUE while the thread waits for the eeprom
+	u8 i;						// loaded route index
+	u16 addr;					// loaded route address
+	rout_entry_t entry;			// loaded route
 
 	// interface
 	
 	// reception fifo
 	fifo_t in_fifo;
-	frame_t in_buf[ROUT_NB_RX];
+	frame_t* in_buf[ROUT_NB_RX];
 
 	frame_t fr;
 
@@ -70,43 +159,379 @@ static struct {
 // private functions
 //
 
-// retrieve the number of registered pairs
-static void ROUT_list(u8* nb_pairs)
+// retrieve the number of registered pairs and the table version
+static void ROUT_list(u8* nb_pairs, u8* version)
 {
 	*nb_pairs = ROUT.nb_pairs;
+	*version = ROUT.eep.version;
+}
+
+
+// find the index of the first pair of a sorted table not lower than the given one
+static u8 ROUT_find(const rout_elem_t* table, const u8 nb, const u8 virtual_addr, const u8 routed_addr)
+{
+	u16 key = ROUT_KEY(virtual_addr, routed_addr);
+	u8 low = 0;
+	u8 high = nb;
+	u8 mid;
+
+	// binary search in the sorted table
+	while ( low < high ) {
+		mid = (low + high) / 2;
+		if ( ROUT_KEY(table[mid].virtual_addr, table[mid].routed_addr) < key ) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+
+// check if the given index of a table holds the given pair
+static u8 ROUT_match(const rout_elem_t* table, const u8 nb, const u8 i, const u8 virtual_addr, const u8 routed_addr)
+{
+	return (i < nb)
+			&& (table[i].virtual_addr == virtual_addr)
+			&& (table[i].routed_addr == routed_addr);
+}
+
+
+// check if the address has routes in the routing table
+static u8 ROUT_is_virtual(const u8 addr)
+{
+	u8 i = ROUT_find(ROUT.table, ROUT.nb_pairs, addr, 0x00);
+
+	return (i < ROUT.nb_pairs) && (ROUT.table[i].virtual_addr == addr);
+}
+
+
+// check if the physical address is the target of a route
+static u8 ROUT_is_target(const u8 addr)
+{
+	u8 i;
+
+	for ( i = 0; i < ROUT.nb_flat; i++ ) {
+		if ( ROUT.flat[i].routed_addr == addr ) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+
+// check if the physical address is marked dead
+static u8 ROUT_is_dead(const u8 addr)
+{
+	return (addr <= DPT_LAST_ADDR) && ROUT_IS_MARKED(ROUT.dead, addr);
+}
+
+
+// find the next dead address to probe
+static u8 ROUT_next_dead(void)
+{
+	u8 i;
+
+	for ( i = 0; i <= DPT_LAST_ADDR; i++ ) {
+		ROUT.probe_addr = (ROUT.probe_addr + 1) & DPT_LAST_ADDR;
+
+		if ( !ROUT_is_dead(ROUT.probe_addr) ) {
+			continue;
+		}
+
+		// an address no more routed is forgotten
+		if ( !ROUT_is_target(ROUT.probe_addr) ) {
+			ROUT_alive(ROUT.probe_addr);
+			continue;
+		}
+
+		return OK;
+	}
+
+	return KO;
+}
+
+
+// retrieve the routing mode entry of the virtual address if any
+static rout_any_t* ROUT_any(const u8 addr)
+{
+	u8 i;
+
+	for ( i = 0; i < ROUT_NB_ANYCAST; i++ ) {
+		if ( (ROUT.any[i].mode != FR_ROUT_ALL) && (ROUT.any[i].virtual_addr == addr) ) {
+			return &ROUT.any[i];
+		}
+	}
+
+	return NULL;
+}
+
+
+// set the routing mode of the virtual address
+static u8 ROUT_mode(const u8 addr, const u8 mode)
+{
+	rout_any_t* any;
+	u8 i;
+
+	if ( mode > FR_ROUT_LATENCY ) {
+		return KO;
+	}
+
+	// find its current entry else a free one
+	any = ROUT_any(addr);
+	for ( i = 0; (any == NULL) && (i < ROUT_NB_ANYCAST); i++ ) {
+		if ( ROUT.any[i].mode == FR_ROUT_ALL ) {
+			any = &ROUT.any[i];
+		}
+	}
+
+	// if every address gets the frame, no entry is needed
+	if ( mode == FR_ROUT_ALL ) {
+		if ( (any != NULL) && (any->virtual_addr == addr) ) {
+			any->mode = FR_ROUT_ALL;
+		}
+		return OK;
+	}
+
+	if ( any == NULL ) {
+		return KO;
+	}
+
+	any->virtual_addr = addr;
+	any->mode = mode;
+	any->next = 0;
+
+	return OK;
+}
+
+
+// retrieve the smoothed latency of the physical address (0 if unknown)
+static u16 ROUT_lat(const u8 addr)
+{
+	u8 i;
+
+	for ( i = 0; i < ROUT_NB_LATENCY; i++ ) {
+		if ( ROUT.lat[i].addr == addr ) {
+			return ROUT.lat[i].latency;
+		}
+	}
+
+	return 0;
+}
+
+
+// expand recursively the address to its physical addresses
+static void ROUT_expand(const u8 addr, u8 list[MAX_ROUTES], u8* list_len)
+{
+	u8 path[ROUT_DEPTH_MAX];	// addresses being expanded
+	u8 next[ROUT_DEPTH_MAX];	// and their next route index
+	u8 depth;
+	u8 routed;
+	u8 i;
+	u8 j = 0;
+
+	path[0] = addr;
+	next[0] = ROUT_find(ROUT.table, ROUT.nb_pairs, addr, 0x00);
+	depth = 1;
+
+	while ( depth ) {
+		i = next[depth - 1];
+
+		// if every route of the current address is expanded
+		if ( (i >= ROUT.nb_pairs) || (ROUT.table[i].virtual_addr != path[depth - 1]) ) {
+			// go back to the previous one
+			depth--;
+			continue;
+		}
+		next[depth - 1]++;
+		routed = ROUT.table[i].routed_addr;
+
+		// if the routed address is virtual and not too deep
+		if ( (routed != path[depth - 1]) && (depth < ROUT_DEPTH_MAX) && ROUT_is_virtual(routed) ) {
+			// if it is already being expanded, the cycle is broken
+			for ( i = 0; (i < depth) && (path[i] != routed); i++ )
+				;
+			if ( i < depth ) {
+				continue;
+			}
+
+			// else expand it
+			path[depth] = routed;
+			next[depth] = ROUT_find(ROUT.table, ROUT.nb_pairs, routed, 0x00);
+			depth++;
+			continue;
+		}
+
+		// else it is appended to the list once up to the list size
+		for ( i = 0; (i < j) && (list[i] != routed); i++ )
+			;
+		if ( (i == j) && (j < *list_len) ) {
+			list[j] = routed;
+			j++;
+		}
+	}
+
+	*list_len = j;
+}
+
+
+// rebuild the expanded routes of the address
+static u8 ROUT_flatten(const u8 addr)
+{
+	u8 list[MAX_ROUTES];
+	u8 nb = MAX_ROUTES;
+	u8 first;
+	u8 last;
+	u8 i;
+
+	// remove its previous expanded routes
+	first = ROUT_find(ROUT.flat, ROUT.nb_flat, addr, 0x00);
+	for ( last = first; (last < ROUT.nb_flat) && (ROUT.flat[last].virtual_addr == addr); last++ )
+		;
+	memmove(&ROUT.flat[first], &ROUT.flat[last], (ROUT.nb_flat - last) * sizeof(rout_elem_t));
+	ROUT.nb_flat -= last - first;
+
+	// compute the new ones
+	ROUT_expand(addr, list, &nb);
+
+	// and insert each of them at its place
+	for ( ; nb > 0; nb-- ) {
+		if ( ROUT.nb_flat >= ROUT_NB_FLAT ) {
+			return KO;
+		}
+
+		i = ROUT_find(ROUT.flat, ROUT.nb_flat, addr, list[nb - 1]);
+		memmove(&ROUT.flat[i + 1], &ROUT.flat[i], (ROUT.nb_flat - i) * sizeof(rout_elem_t));
+		ROUT.flat[i].virtual_addr = addr;
+		ROUT.flat[i].routed_addr = list[nb - 1];
+		ROUT.nb_flat++;
+	}
+
+	return OK;
+}
+
+
+// rebuild the expanded routes of the address and of the ones reaching it
+static u8 ROUT_update(const u8 addr)
+{
+	u8 marks[256 / 8];
+	u8 changed;
+	u8 res = OK;
+	u8 i;
+
+	// mark the address
+	memset(marks, 0, sizeof(marks));
+	ROUT_MARK(marks, addr);
+
+	// then the ones routed to a marked address until no more is found
+	do {
+		changed = FALSE;
+		for ( i = 0; i < ROUT.nb_pairs; i++ ) {
+			if ( ROUT_IS_MARKED(marks, ROUT.table[i].routed_addr) && !ROUT_IS_MARKED(marks, ROUT.table[i].virtual_addr) ) {
+				ROUT_MARK(marks, ROUT.table[i].virtual_addr);
+				changed = TRUE;
+			}
+		}
+	} while ( changed );
+
+	// rebuild the expanded routes of every marked address
+	i = 0;
+	do {
+		if ( ROUT_IS_MARKED(marks, i) && (KO == ROUT_flatten(i)) ) {
+			res = KO;
+		}
+	} while ( ++i != 0 );
+
+	return res;
+}
+
+
+// insert a pair in the routing table
+static u8 ROUT_insert(const u8 virtual_addr, const u8 routed_addr)
+{
+	u8 i;
+
+	// check if there is no more place left
+	if ( ROUT.nb_pairs >= ROUT_NB_PAIRS ) {
+		return KO;
+	}
+
+	// insert the new pair by shifting the end of the table by one
+	i = ROUT_find(ROUT.table, ROUT.nb_pairs, virtual_addr, routed_addr);
+	memmove(&ROUT.table[i + 1], &ROUT.table[i], (ROUT.nb_pairs - i) * sizeof(rout_elem_t));
+	ROUT.table[i].virtual_addr = virtual_addr;
+	ROUT.table[i].routed_addr = routed_addr;
+
+	// update the pairs counter
+	ROUT.nb_pairs++;
+
+	return OK;
+}
+
+
+// remove a pair of the routing table
+static void ROUT_remove(const u8 i)
+{
+	// it is deleted by shifting the end of the table by one
+	memmove(&ROUT.table[i], &ROUT.table[i + 1], (ROUT.nb_pairs - i - 1) * sizeof(rout_elem_t));
+
+	// there is now one less pair
+	ROUT.nb_pairs--;
 }
 
 
 // retrieve the content of the given line if it exists
-static u8 ROUT_line(const u8 line, u8* virtual_addr, u8* routed_addr)
+static u8 ROUT_line(const u8 line, u8* virtual_addr, u8* routed_addr, u8* mode)
 {
+	rout_any_t* any;
+
 	// check if the required line exists
-	if ( line > ROUT.nb_pairs ) {
+	if ( line >= ROUT.nb_pairs ) {
 		return KO;
 	}
 
 	// retrieve the line
 	*virtual_addr = ROUT.table[line].virtual_addr;
 	*routed_addr = ROUT.table[line].routed_addr;
+	any = ROUT_any(*virtual_addr);
+	*mode = (any != NULL) ? any->mode : FR_ROUT_ALL;
 
 	return OK;
 }
 
 
 // add a new pair if possible
-static u8 ROUT_add(const u8 virtual_addr, const u8 routed_addr)
+// and set the routing mode of the virtual address
+static u8 ROUT_add(const u8 virtual_addr, const u8 routed_addr, const u8 mode)
 {
-	// check if there is no more place left
-	if ( ROUT.nb_pairs >= MAX_ROUTES ) {
+	u8 keep;
+	u8 i;
+
+	// the mode is left unchanged when none is given
+	// (a new address then gets the default one : FR_ROUT_ALL)
+	keep = (mode == FR_ROUT_KEEP);
+
+	// if the pair is already present, only the mode is set
+	i = ROUT_find(ROUT.table, ROUT.nb_pairs, virtual_addr, routed_addr);
+	if ( ROUT_match(ROUT.table, ROUT.nb_pairs, i, virtual_addr, routed_addr) ) {
+		return keep ? OK : ROUT_mode(virtual_addr, mode);
+	}
+
+	if ( KO == ROUT_insert(virtual_addr, routed_addr) ) {
 		return KO;
 	}
 
-	// add the new pair at the end of the list
-	ROUT.table[ROUT.nb_pairs].virtual_addr = virtual_addr;
-	ROUT.table[ROUT.nb_pairs].routed_addr = routed_addr;
+	// if the expanded routes don't fit or the mode can't be set
+	if ( (KO == ROUT_update(virtual_addr)) || (!keep && (KO == ROUT_mode(virtual_addr, mode))) ) {
+		// the pair is removed
+		ROUT_remove(i);
+		ROUT_update(virtual_addr);
 
-	// update the pairs counter
-	ROUT.nb_pairs++;
+		return KO;
+	}
 
 	return OK;
 }
@@ -115,40 +540,109 @@ static u8 ROUT_add(const u8 virtual_addr, const u8 routed_addr)
 // suppress a pair if it exists
 static u8 ROUT_del(const u8 virtual_addr, const u8 routed_addr)
 {
-	u8 match_index = MAX_ROUTES;
 	u8 i;
 
-	// scan the table to find the matching pair
-	for ( i = 0; i < ROUT.nb_pairs; i++ ) {
-		if ( (ROUT.table[i].virtual_addr == virtual_addr) && (ROUT.table[i].routed_addr == routed_addr) ) {
-			match_index = i;
-			break;
-		}
-	}
+	// search the matching pair
+	i = ROUT_find(ROUT.table, ROUT.nb_pairs, virtual_addr, routed_addr);
 
 	// if no matching pair is found
-	if ( match_index == MAX_ROUTES ) {
+	if ( !ROUT_match(ROUT.table, ROUT.nb_pairs, i, virtual_addr, routed_addr) ) {
 		return KO;
 	}
 
-	// if a matching pair is found
-	// it is deleted by shifting the end of the table by one
-	for ( i = match_index; i < ROUT.nb_pairs - 1; i++ ) {
-		ROUT.table[i] = ROUT.table[i + 1];
-	}	
+	ROUT_remove(i);
 
-	// there is now one less pair
-	ROUT.nb_pairs--;
+	// if the expanded routes don't fit
+	if ( KO == ROUT_update(virtual_addr) ) {
+		// the pair is restored
+		ROUT_insert(virtual_addr, routed_addr);
+		ROUT_update(virtual_addr);
+
+		return KO;
+	}
+
+	// an address without route has no more routing mode
+	if ( !ROUT_is_virtual(virtual_addr) ) {
+		(void)ROUT_mode(virtual_addr, FR_ROUT_ALL);
+	}
 
 	return OK;
 }
 
+// compute the checksum of the table to be saved
+static u8 ROUT_sum(void)
+{
+	u8* p = (u8*)ROUT.table;
+	u8 sum;
+	u8 i;
+
+	sum = ROUT.eep.version + ROUT.eep.nb_pairs;
+
+	for ( i = 0; i < ROUT.eep.nb_pairs * sizeof(rout_elem_t); i++ ) {
+		sum += p[i];
+	}
+
+	// the round-robin state is not part of the table
+	for ( i = 0; i < ROUT_NB_ANYCAST; i++ ) {
+		sum += ROUT.any[i].virtual_addr + ROUT.any[i].mode;
+	}
+
+	return sum;
+}
+
+
+// restore the table saved in eeprom
+static void ROUT_restore(void)
+{
+	u8 i;
+
+	// read the header
+	EEP_read(ROUT_EEP_HEADER, (u8*)&ROUT.eep, sizeof(rout_eep_t));
+	while ( ! EEP_is_fini() )
+		;
+
+	// a blank or a too large table is ignored
+	if ( ROUT.eep.nb_pairs > ROUT_NB_PAIRS ) {
+		ROUT.eep.version = 0;
+		return;
+	}
+
+	// read the routing modes and the pairs
+	EEP_read(ROUT_EEP_ANY, (u8*)ROUT.any, sizeof(ROUT.any));
+	while ( ! EEP_is_fini() )
+		;
+
+	EEP_read(ROUT_EEP_PAIRS, (u8*)ROUT.table, ROUT.eep.nb_pairs * sizeof(rout_elem_t));
+	while ( ! EEP_is_fini() )
+		;
+
+	// if the table is corrupted, it is discarded
+	if ( ROUT.eep.sum != ROUT_sum() ) {
+		memset(ROUT.any, 0, sizeof(ROUT.any));
+		ROUT.eep.version = 0;
+		return;
+	}
+
+	for ( i = 0; i < ROUT_NB_ANYCAST; i++ ) {
+		ROUT.any[i].next = 0;
+	}
+	ROUT.nb_pairs = ROUT.eep.nb_pairs;
+
+	// expand each virtual address once
+	for ( i = 0; i < ROUT.nb_pairs; i++ ) {
+		if ( (i == 0) || (ROUT.table[i].virtual_addr != ROUT.table[i - 1].virtual_addr) ) {
+			(void)ROUT_flatten(ROUT.table[i].virtual_addr);
+		}
+	}
+}
+
+
 static PT_THREAD( ROUT_rout(pt_t* pt) )
 {
 	PT_BEGIN(pt);
 
 	// if a frame is received
-	PT_WAIT_UNTIL(pt, FIFO_get(&ROUT.in_fifo, &ROUT.fr));
+	PT_WAIT_UNTIL(pt, DPT_rx(&ROUT.interf, &ROUT.fr));
 
 	// if it is a response
 	if ( ROUT.fr.resp ) {
@@ -159,19 +653,79 @@ static PT_THREAD( ROUT_rout(pt_t* pt) )
 	// treat it
 	switch ( ROUT.fr.cmde ) {
 		case FR_ROUT_LIST:
-			ROUT_list(&ROUT.fr.argv[1]);
+			ROUT_list(&ROUT.fr.argv[1], &ROUT.fr.argv[2]);
 			break;
 
 		case FR_ROUT_LINE:
-			ROUT.fr.argv[3] = ROUT_line(ROUT.fr.argv[0], &ROUT.fr.argv[1], &ROUT.fr.argv[2]);
+			ROUT.fr.argv[3] = ROUT_line(ROUT.fr.argv[0], &ROUT.fr.argv[1], &ROUT.fr.argv[2], &ROUT.fr.argv[4]);
 			break;
 
 		case FR_ROUT_ADD:
-			ROUT.fr.argv[2] = ROUT_add(ROUT.fr.argv[0], ROUT.fr.argv[1]);
+			ROUT.fr.argv[2] = ROUT_add(ROUT.fr.argv[0], ROUT.fr.argv[1], ROUT.fr.argv[3]);
+			if ( ROUT.fr.argv[2] == OK ) {
+				ROUT.eep.version = 0;
+				ROUT.is_modified = TRUE;
+			}
 			break;
 
 		case FR_ROUT_DEL:
 			ROUT.fr.argv[2] = ROUT_del(ROUT.fr.argv[0], ROUT.fr.argv[1]);
+			if ( ROUT.fr.argv[2] == OK ) {
+				ROUT.eep.version = 0;
+				ROUT.is_modified = TRUE;
+			}
+			break;
+
+		case FR_ROUT_LOAD:
+			// a node with the current table is not reprogrammed
+			if ( (ROUT.fr.argv[4] != 0) && (ROUT.fr.argv[4] == ROUT.eep.version) ) {
+				ROUT.fr.argv[5] = OK;
+				break;
+			}
+
+			// check the memory storage zone
+			if ( (ROUT.fr.argv[3] != EEPROM_STORAGE) && (ROUT.fr.argv[3] != RAM_STORAGE) && (ROUT.fr.argv[3] != FLASH_STORAGE) ) {
+				// frame format is invalid
+				ROUT.fr.error = 1;
+				break;
+			}
+
+			// the loaded routes replace the whole table
+			ROUT.is_eep_busy = TRUE;
+			ROUT.nb_pairs = 0;
+			ROUT.nb_flat = 0;
+			memset(ROUT.any, 0, sizeof(ROUT.any));
+			ROUT.fr.argv[5] = OK;
+			ROUT.is_modified = TRUE;
+
+			// for each route in the block
+			for ( ROUT.i = 0; ROUT.i < ROUT.fr.argv[2]; ROUT.i++ ) {
+				ROUT.addr = (u16)(ROUT.fr.argv[0] << 8) + ROUT.fr.argv[1] + ROUT.i * sizeof(rout_entry_t);
+
+				// extract the route upon the memory storage zone
+				if ( ROUT.fr.argv[3] == EEPROM_STORAGE ) {
+					EEP_read(ROUT.addr, (u8*)&ROUT.entry, sizeof(rout_entry_t));
+
+					// wait until reading is done
+					PT_WAIT_UNTIL(pt, EEP_is_fini());
+				}
+				else if ( ROUT.fr.argv[3] == RAM_STORAGE ) {
+					ROUT.entry = *((rout_entry_t*)ROUT.addr);
+				}
+				else {
+					memcpy_P(&ROUT.entry, (const void*)ROUT.addr, sizeof(rout_entry_t));
+				}
+
+				// stop at the first route not fitting
+				if ( KO == ROUT_add(ROUT.entry.virtual_addr, ROUT.entry.routed_addr, ROUT.entry.mode) ) {
+					ROUT.fr.argv[5] = KO;
+					break;
+				}
+			}
+
+			// a partially loaded table has no version
+			ROUT.eep.version = (ROUT.fr.argv[5] == OK) ? ROUT.fr.argv[4] : 0;
+			ROUT.is_eep_busy = FALSE;
 			break;
 
 		default:
@@ -183,6 +737,29 @@ static PT_THREAD( ROUT_rout(pt_t* pt) )
 	ROUT.fr.resp = 1;
 	PT_WAIT_UNTIL(pt, DPT_tx(&ROUT.interf, &ROUT.fr));
 
+	// save the modified table
+	if ( ROUT.is_modified ) {
+		ROUT.is_modified = FALSE;
+		ROUT.is_eep_busy = TRUE;
+
+		// the eeprom block holds the whole table
+		ROUT.eep.nb_pairs = ROUT.nb_pairs;
+		ROUT.eep.sum = ROUT_sum();
+
+		if ( ROUT.nb_pairs ) {
+			PT_WAIT_UNTIL(pt, EEP_write(ROUT_EEP_PAIRS, (u8*)ROUT.table, ROUT.nb_pairs * sizeof(rout_elem_t)));
+			PT_WAIT_UNTIL(pt, EEP_is_fini());
+		}
+
+		PT_WAIT_UNTIL(pt, EEP_write(ROUT_EEP_ANY, (u8*)ROUT.any, sizeof(ROUT.any)));
+		PT_WAIT_UNTIL(pt, EEP_is_fini());
+
+		// the header is written last so an interrupted save is detected at restore
+		PT_WAIT_UNTIL(pt, EEP_write(ROUT_EEP_HEADER, (u8*)&ROUT.eep, sizeof(rout_eep_t)));
+		PT_WAIT_UNTIL(pt, EEP_is_fini());
+		ROUT.is_eep_busy = FALSE;
+	}
+
 	// unlock the channel if no more frame are unqueued
 	if ( FIFO_full(&ROUT.in_fifo) == 0 ) {
 		DPT_unlock(&ROUT.interf);
@@ -195,6 +772,42 @@ static PT_THREAD( ROUT_rout(pt_t* pt) )
 }
 
 
+static PT_THREAD( ROUT_probe(pt_t* pt) )
+{
+	frame_t fr;
+
+	PT_BEGIN(pt);
+
+	// wait for the next probe time
+	PT_WAIT_UNTIL(pt, ROUT.nb_dead && (TIME_get() > ROUT.probe_time));
+	ROUT.probe_time = TIME_get() + ROUT_PROBE_PERIOD;
+
+	// if no dead address is still routed
+	if ( KO == ROUT_next_dead() ) {
+		PT_RESTART(pt);
+	}
+
+	// test if the address responds
+	ROUT.probe.orig = 0;
+	ROUT.probe.dest = ROUT.probe_addr;
+	ROUT.probe.status = 0;
+	ROUT.probe.cmde = FR_I2C_READ;
+	PT_WAIT_UNTIL(pt, DPT_call(&ROUT.interf, &ROUT.probe, ROUT_PROBE_TIME_OUT, &ROUT.call));
+	PT_WAIT_UNTIL(pt, DPT_call_done(&ROUT.interf, ROUT.call, &fr));
+
+	// the dispatcher reports the result of the transfer
+	// but a local failure (no free frame, time-out) is not a response
+	if ( fr.resp && !fr.error && !fr.time_out ) {
+		ROUT_alive(ROUT.probe_addr);
+	}
+
+	// loop back for next probe
+	PT_RESTART(pt);
+
+	PT_END(pt);
+}
+
+
 //------------------------------------------
 // pthread interface
 //
@@ -203,12 +816,27 @@ void ROUT_init(void)
 {
 	// reset internals
 	ROUT.nb_pairs = 0;
+	ROUT.nb_flat = 0;
+	memset(ROUT.dead, 0, sizeof(ROUT.dead));
+	ROUT.nb_dead = 0;
+	memset(ROUT.any, 0, sizeof(ROUT.any));
+	memset(ROUT.lat, 0, sizeof(ROUT.lat));
+	ROUT.lat_idx = 0;
+	ROUT.probe_addr = 0;
+	ROUT.probe_time = 0;
+	PT_INIT(&ROUT.probe_pt);
+	ROUT.is_modified = FALSE;
+	ROUT.is_eep_busy = FALSE;
 	FIFO_init(&ROUT.in_fifo, &ROUT.in_buf, ROUT_NB_RX, sizeof(ROUT.in_buf[0]));
 	PT_INIT(&ROUT.pt);
 
+	// restore the saved table
+	// (the eeprom driver is started by BSC_init)
+	ROUT_restore();
+
 	// register to dispatcher
 	ROUT.interf.channel = 9;
-	ROUT.interf.cmde_mask = _CM(FR_ROUT_LIST) | _CM(FR_ROUT_LINE) | _CM(FR_ROUT_ADD) | _CM(FR_ROUT_DEL);
+	ROUT.interf.cmde_mask = FR_MASK_ROUT;
 	ROUT.interf.queue = &ROUT.in_fifo;
 	DPT_register(&ROUT.interf);
 }
@@ -216,8 +844,24 @@ void ROUT_init(void)
 
 void ROUT_run(void)
 {
+	// nothing to do until a frame is received
+	if ( !DPT_ready(&ROUT.interf) ) {
+		return;
+	}
+
 	// just handle the frame requests
 	(void)PT_SCHEDULE(ROUT_rout(&ROUT.pt));
+
+	// the eeprom is polled until the access is done
+	if ( ROUT.is_eep_busy ) {
+		DPT_wake(&ROUT.interf);
+	}
+
+	// and probe the dead addresses
+	(void)PT_SCHEDULE(ROUT_probe(&ROUT.probe_pt));
+	if ( ROUT.nb_dead ) {
+		DPT_wake_at(&ROUT.interf, ROUT.probe_time);
+	}
 }
 
 
@@ -228,20 +872,122 @@ void ROUT_run(void)
 // retrieve the routed addresses from the specified address
 void ROUT_route(const u8 addr, u8 list[MAX_ROUTES], u8* list_len)
 {
+	rout_any_t* any;
+	u8 first;
+	u8 skip_dead = FALSE;
 	u8 i;
 	u8 j = 0;
+	u8 k;
+
+	// the expanded routes of the address follow its first one
+	first = ROUT_find(ROUT.flat, ROUT.nb_flat, addr, 0x00);
+
+	// if any of them responds, the dead ones are skipped
+	if ( ROUT.nb_dead ) {
+		for ( i = first; (i < ROUT.nb_flat) && (ROUT.flat[i].virtual_addr == addr); i++ ) {
+			if ( !ROUT_is_dead(ROUT.flat[i].routed_addr) ) {
+				skip_dead = TRUE;
+				break;
+			}
+		}
+	}
+
+	for ( i = first; (i < ROUT.nb_flat) && (ROUT.flat[i].virtual_addr == addr); i++ ) {
+		if ( skip_dead && ROUT_is_dead(ROUT.flat[i].routed_addr) ) {
+			continue;
+		}
 
-	// scan the routing table
-	for ( i = 0; i < ROUT.nb_pairs; i++ ) {
 		// append the routed address to the list up to the list size
-		if ( ROUT.table[i].virtual_addr == addr ) {
-			if ( j < *list_len ) {
-				list[j] = ROUT.table[i].routed_addr;
-				j++;
+		if ( j < *list_len ) {
+			list[j] = ROUT.flat[i].routed_addr;
+			j++;
+		}
+	}
+
+	// if only one of them shall get the frame
+	any = ROUT_any(addr);
+	if ( (any != NULL) && (j > 1) ) {
+		// the next one in turn
+		if ( any->mode == FR_ROUT_ROUND_ROBIN ) {
+			i = any->next % j;
+			any->next = i + 1;
+		}
+		// or the fastest one
+		else {
+			i = 0;
+			for ( k = 1; k < j; k++ ) {
+				if ( ROUT_lat(list[k]) < ROUT_lat(list[i]) ) {
+					i = k;
+				}
 			}
 		}
+
+		list[0] = list[i];
+		j = 1;
 	}
 
 	// return the number of routed addresses
 	*list_len = j;
 }
+
+
+void ROUT_dead(const u8 addr)
+{
+	// only the routed physical addresses are followed
+	if ( (addr < DPT_FIRST_ADDR) || (addr > DPT_LAST_ADDR) || ROUT_is_dead(addr) || !ROUT_is_target(addr) ) {
+		return;
+	}
+
+	ROUT_MARK(ROUT.dead, addr);
+	ROUT.nb_dead++;
+
+	// the first probe will come after a while
+	if ( ROUT.nb_dead == 1 ) {
+		ROUT.probe_time = TIME_get() + ROUT_PROBE_PERIOD;
+	}
+	DPT_wake_at(&ROUT.interf, ROUT.probe_time);
+}
+
+
+void ROUT_alive(const u8 addr)
+{
+	if ( !ROUT_is_dead(addr) ) {
+		return;
+	}
+
+	ROUT.dead[addr >> 3] &= ~(1 << (addr & 0x07));
+	ROUT.nb_dead--;
+}
+
+
+void ROUT_latency(const u8 addr, u32 latency)
+{
+	u8 i;
+
+	// only the latencies used by the routing are kept
+	for ( i = 0; i < ROUT_NB_ANYCAST; i++ ) {
+		if ( ROUT.any[i].mode == FR_ROUT_LATENCY ) {
+			break;
+		}
+	}
+	if ( (i == ROUT_NB_ANYCAST) || !ROUT_is_target(addr) ) {
+		return;
+	}
+
+	if ( latency > 0xffff ) {
+		latency = 0xffff;
+	}
+
+	// smooth the known latency
+	for ( i = 0; i < ROUT_NB_LATENCY; i++ ) {
+		if ( ROUT.lat[i].addr == addr ) {
+			ROUT.lat[i].latency = (3 * (u32)ROUT.lat[i].latency + latency) / 4;
+			return;
+		}
+	}
+
+	// else record it in place of the oldest entry
+	ROUT.lat[ROUT.lat_idx].addr = addr;
+	ROUT.lat[ROUT.lat_idx].latency = latency;
+	ROUT.lat_idx = (ROUT.lat_idx + 1) % ROUT_NB_LATENCY;
+}
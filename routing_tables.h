@@ -16,10 +16,39 @@
 //
 // implementation :
 //
-// the routing table is a very simple list with
-// an virtual address and a routing address.
-//
-// the whole table is scanned,
+// the routing table is a list of pairs with
+// an virtual address and a routing address,
+// sorted by virtual address then by routing address.
+//
+// the routes of a virtual address are found by a binary search
+// and follow each other in the table.
+//
+// each virtual address is expanded recursively to physical addresses,
+// each one being given once.
+// a route to an address already being expanded (cycle) is ignored
+// and a route of an address to itself or too deep
+// is taken as a physical address.
+// the expanded routes are kept in a second sorted table,
+// updated for the virtual addresses reaching the modified one
+// when a pair is added or deleted.
+// so routing a frame is a single search in this table.
+//
+// the physical addresses which don't respond are marked dead
+// and the frames for a virtual address only go to its responding ones
+// (unless none responds).
+// a dead address is probed regularly until it responds again.
+//
+// a virtual address can also route the frames to only one
+// of its routed addresses, chosen in turn
+// or as the one with the lowest response latency.
+// the mode is set when adding a route and applies to the address itself,
+// not to the virtual addresses it is nested in.
+//
+// the routing table can be replaced at once by a block of routes
+// read from eeprom, flash or ram.
+// the table is saved in eeprom after each change with its version
+// and a checksum and it is restored at start-up.
+// a node whose table has the requested version is not reprogrammed.
 //
 // if no match is found between the given address and a table input,
 // the given address is considered as a physical address and is left untranslated.
@@ -39,9 +68,44 @@
 // configuration
 //
 
-// maximum number of routes
+// maximum number of routes for an address
 #define MAX_ROUTES	10
 
+// incoming frames buffer size
+#ifndef ROUT_NB_RX
+# define ROUT_NB_RX	3
+#endif
+
+// routing table capacity (up to 255 pairs, 2 bytes of RAM and of eeprom each)
+// the default fits the 2 KB of RAM of the atmega328p with the other modules,
+// 128 pairs take 192 more bytes of RAM
+#ifndef ROUT_NB_PAIRS
+# define ROUT_NB_PAIRS	32
+#endif
+
+// expanded routes table capacity (up to 255 pairs, 2 bytes of RAM each)
+#ifndef ROUT_NB_FLAT
+# define ROUT_NB_FLAT	32
+#endif
+
+// virtual addresses routed to only one address
+#ifndef ROUT_NB_ANYCAST
+# define ROUT_NB_ANYCAST	4
+#endif
+
+// maximum nesting of virtual addresses
+#define ROUT_DEPTH_MAX	8
+
+// place of the saved routing table in eeprom
+// (between the event frames and the log area, see log.h)
+// it holds the whole table : 3 bytes of header, 3 bytes per routing mode and 2 bytes per pair
+#ifndef ROUT_EEP_ADDR
+# define ROUT_EEP_ADDR	0x100
+#endif
+#ifndef ROUT_EEP_SIZE
+# define ROUT_EEP_SIZE	(3 + ROUT_NB_ANYCAST * 3 + ROUT_NB_PAIRS * 2)
+#endif
+
 
 //------------------------------------------
 // pthread interface
@@ -58,4 +122,13 @@ extern void ROUT_run(void);
 // retrieve the routed addresses from the specified address
 extern void ROUT_route(const u8 addr, u8 list[MAX_ROUTES], u8* list_len);
 
+// report a physical address not responding (no slave, time-out)
+extern void ROUT_dead(const u8 addr);
+
+// report a physical address responding
+extern void ROUT_alive(const u8 addr);
+
+// report the response latency of a physical address
+extern void ROUT_latency(const u8 addr, u32 latency);
+
 #endif	// __ROUT_H__
@@ -32,7 +32,7 @@
 // private defines
 //
 
-#define QUEUE_SIZE		1
+#define TSN_RESP_TIME_OUT	(TIME_1_SEC / 2)
 
 
 //----------------------------------------
@@ -49,8 +49,7 @@ static struct {
 	u32 time_out;
 	s8 time_correction;
 
-	fifo_t queue;				// reception queue
-	frame_t buf[QUEUE_SIZE];
+	u8 call;					// time request
 } TSN;
 
 
@@ -88,15 +87,16 @@ static PT_THREAD( TSN_tsn(pt_t* pt) )
 	TSN.fr.serial = 0;
 
 	// send the time request
-	DPT_lock(&TSN.interf);
-	PT_WAIT_UNTIL(pt, OK == DPT_tx(&TSN.interf, &TSN.fr));
-	DPT_unlock(&TSN.interf);
+	PT_WAIT_UNTIL(pt, OK == DPT_call(&TSN.interf, &TSN.fr, TSN_RESP_TIME_OUT, &TSN.call));
 
 	// wait for the answer
-	PT_WAIT_UNTIL(pt, FIFO_get(&TSN.queue, &TSN.fr) && TSN.fr.resp);
+	PT_WAIT_UNTIL(pt, DPT_call_done(&TSN.interf, TSN.call, &TSN.fr));
 
-	// immediatly unlock
-	DPT_unlock(&TSN.interf);
+	// if the BC didn't give its time
+	if ( TSN.fr.error || TSN.fr.time_out ) {
+		// keep the current correction until the next request
+		PT_RESTART(pt);
+	}
 
 	// rebuild remote time (AVR is little endian)
 	remote_time.part[0] = TSN.fr.argv[3];
@@ -144,12 +144,12 @@ void TSN_init(void)
 	TSN.time_correction = 0;
 	TSN.time_out = TIME_1_SEC;
 	TIME_set_incr(10 * TIME_1_MSEC);
-	FIFO_init(&TSN.queue, &TSN.buf, QUEUE_SIZE, sizeof(TSN.buf) / sizeof(TSN.buf[0]));
 
 	// register to dispatcher
+	// the response is received through the call
 	TSN.interf.channel = 8;
-	TSN.interf.cmde_mask = _CM(FR_TIME_GET);
-	TSN.interf.queue = &TSN.queue;
+	TSN.interf.cmde_mask = NULL;
+	TSN.interf.queue = NULL;
 	DPT_register(&TSN.interf);
 }
 
@@ -157,6 +157,14 @@ void TSN_init(void)
 // Time Synchro module run method
 void TSN_run(void)
 {
+	// nothing to do until the response or the next request time
+	if ( !DPT_ready(&TSN.interf) ) {
+		return;
+	}
+
 	// send response if any
 	(void)PT_SCHEDULE(TSN_tsn(&TSN.pt));
+
+	// next time request
+	DPT_wake_at(&TSN.interf, TSN.time_out);
 }